@@ -4,3 +4,4 @@ set CommonCompilerFlags=-Od -FC -GR- -Oi -MP -WL -Z7 -nologo -EHsc -Fobin/ -DDEB
 set CommonLinkerFlags=-incremental:no -opt:ref /LIBPATH:thirdparty/ "User32.lib" "Gdi32.lib" "kernel32.lib" "glfw3dll.lib" "raylibdll.lib"
 
 cl %CommonCompilerFlags% src/main.cpp /Febin/ld48 /Fdbin/ld48 /link %CommonLinkerFlags%
+cl %CommonCompilerFlags% src/atlas_builder.cpp /Febin/atlas_builder /Fdbin/atlas_builder /link %CommonLinkerFlags%
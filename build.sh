@@ -8,3 +8,7 @@ printf "Building game..."
 clang $clang_args  src/main.cpp -g $game_defs  -Lthirdparty/ -Ithirdparty/ -lm -lX11 -ldl -lglfw -lraylib -lpthread $clang_linker -o bin/ld48
 printf "done.\n"
 
+printf "Building atlas builder..."
+clang $clang_args  src/atlas_builder.cpp -g  -Lthirdparty/ -Ithirdparty/ -lm -lX11 -ldl -lglfw -lraylib -lpthread $clang_linker -o bin/atlas_builder
+printf "done.\n"
+
@@ -0,0 +1,222 @@
+
+// Enemy behaviour. Deciding what to do (noticing the player, choosing between
+// patrol, chase and shoot, picking a target) is time sliced: each tick at most
+// AI_DECISIONS_PER_TICK enemies think, taken round robin from a cursor into the
+// entity list. Every enemy still steers each tick from whatever its last
+// decision left behind, which is a velocity write and, when shooting, a timer
+// compare. A crowd noticing the player at once spreads over several ticks.
+//
+// Frozen enemies neither think nor steer, the entity list only moves them when
+// they're in range anyway.
+//
+// Grounded enemies also keep apart: each one looks at up to AI_MAX_NEIGHBOURS
+// other enemies within AI_SEPARATION_RADIUS through the spatial grid, steers
+// away from them and matches their average speed a little, so crowds spread
+// along a platform instead of stacking on one spot. The neighbour and scan
+// caps keep the pass linear however dense a crowd gets.
+
+static constexpr u32 AI_DECISIONS_PER_TICK = 64;
+static constexpr u32 AI_MAX_SCAN_PER_TICK = 1024;
+static constexpr f32 AI_NOTICE_DISTANCE = 240.f;
+static constexpr f32 AI_LOSE_DISTANCE = 400.f;
+static constexpr f32 AI_SHOOT_DISTANCE = 140.f;
+static constexpr f32 AI_SHOOT_HEIGHT = 48.f;
+static constexpr f32 AI_PATROL_RANGE = 64.f;
+static constexpr f32 AI_PATROL_SPEED = 0.3f;
+static constexpr f32 AI_CHASE_SPEED = 0.7f;
+static constexpr f32 AI_SHOT_SPEED = 4.f;
+static constexpr f32 AI_SHOT_LIFETIME = 1.5f;
+static constexpr u32 AI_SHOT_INTERVAL = 90; // Ticks
+static constexpr f32 AI_SEPARATION_RADIUS = 24.f;
+static constexpr f32 AI_SEPARATION_WEIGHT = 0.5f;
+static constexpr f32 AI_ALIGNMENT_WEIGHT = 0.2f;
+static constexpr u32 AI_MAX_NEIGHBOURS = 8;
+static constexpr u32 AI_MAX_NEIGHBOUR_SCAN = 32;
+
+struct Ai_Stats {
+    u32 active;
+    u32 decisions;
+    u32 shots;
+    u32 neighbours;
+    f32 tick_ms;
+};
+static Ai_Stats g_ai_stats;
+static u32 g_ai_cursor;
+
+inline static Vector2
+get_center(Entity *entity) {
+    Rectangle bounds = get_bounds(entity);
+    return {bounds.x + bounds.width * 0.5f, bounds.y + bounds.height * 0.5f};
+}
+
+static void
+decide_ai(Entity *entity, Entity *player_entity, u32 tick) {
+    if(entity->ai_state == AI_STATE_IDLE) {
+        // Factories place enemies after creating them, patrol around wherever they ended up
+        entity->ai_home_x = entity->pos.x;
+        entity->ai_dir = (entity->id & 1) ? 1.f : -1.f;
+        entity->ai_state = AI_STATE_PATROL;
+    }
+
+    Vector2 to_player = sub_vec2(get_center(player_entity), get_center(entity));
+    f32 distance = sqrtf(to_player.x*to_player.x + to_player.y*to_player.y);
+    bool player_alive = (player_entity->hp > 0.f);
+
+    if(player_alive && fabsf(to_player.x) < AI_SHOOT_DISTANCE && fabsf(to_player.y) < AI_SHOOT_HEIGHT) {
+        if(entity->ai_state != AI_STATE_SHOOT) {
+            // Don't fire on the tick the player is noticed
+            entity->ai_next_shot = tick + AI_SHOT_INTERVAL / 2 + (entity->id % AI_SHOT_INTERVAL) / 2;
+        }
+        entity->ai_state = AI_STATE_SHOOT;
+    } else if(player_alive && (distance < AI_NOTICE_DISTANCE || (entity->ai_state != AI_STATE_PATROL && distance < AI_LOSE_DISTANCE))) {
+        entity->ai_state = AI_STATE_CHASE;
+        entity->ai_target_x = get_center(player_entity).x;
+    } else if(entity->ai_state != AI_STATE_PATROL) {
+        entity->ai_state = AI_STATE_PATROL;
+        entity->ai_home_x = entity->pos.x;
+    }
+}
+
+static void
+steer_ai(Entity *entity, Entity *player_entity, u32 tick) {
+    switch(entity->ai_state) {
+        case AI_STATE_PATROL: {
+            f32 end_x = entity->ai_home_x + entity->ai_dir * AI_PATROL_RANGE;
+            if((end_x - entity->pos.x) * entity->ai_dir <= 0.f) {
+                entity->ai_dir = -entity->ai_dir;
+            }
+            entity->velocity.x = entity->ai_dir * AI_PATROL_SPEED;
+        } break;
+
+        case AI_STATE_CHASE: {
+            // Committed to a jump or drop until landing, keep pushing the same way
+            if(entity->phys_state != PHYS_STATE_STANDING) {
+                entity->velocity.x = entity->ai_dir * AI_CHASE_SPEED;
+                break;
+            }
+
+            // Off the player's platform, follow the shared flow field instead
+            f32 center_x = get_center(entity).x;
+            Nav_Link *link = get_nav_flow(g_nav, entity->ground);
+            f32 dx = (link ? link->x : entity->ai_target_x) - center_x;
+
+            if(fabsf(dx) < 8.f) {
+                entity->velocity.x = 0.f;
+                if(link && link->type == NAV_LINK_JUMP) {
+                    Nav_Node *to = &g_nav->nodes[link->to];
+                    entity->ai_dir = signof((to->x0 + to->x1) * 0.5f - center_x);
+                    entity->velocity.x = entity->ai_dir * AI_CHASE_SPEED;
+                    entity->velocity.y = -1.5f;
+                    entity->ground = 0;
+                    entity->phys_state = PHYS_STATE_JUMPING;
+                }
+            } else {
+                entity->ai_dir = signof(dx);
+                entity->velocity.x = entity->ai_dir * AI_CHASE_SPEED;
+            }
+        } break;
+
+        case AI_STATE_SHOOT: {
+            entity->velocity.x = 0.f;
+            if(tick < entity->ai_next_shot) break;
+            entity->ai_next_shot = tick + AI_SHOT_INTERVAL;
+
+            // Aim is cheap enough to take every shot, only the decision to shoot is sliced
+            Vector2 muzzle = get_center(entity);
+            Vector2 aim = normalize(sub_vec2(get_center(player_entity), muzzle));
+            if(spawn_projectile(&g_projectiles, muzzle, mul_vec2_f(aim, AI_SHOT_SPEED), entity->id,
+                                ENTITY_FLAG_CORPO, ticks_from_seconds(AI_SHOT_LIFETIME))) {
+                g_ai_stats.shots += 1;
+                if(entity->sim_tier == SIM_TIER_FULL) {
+                    play_sound(SOUND_SHOOT);
+                }
+            }
+        } break;
+    }
+}
+
+// The grid is the one built at the end of last tick. Entities have moved since
+// and a zone load may have replaced them all, every candidate is checked anyway.
+static void
+separate_ai(Entity *entity, Entity_List *entity_list, Spatial_Grid *grid) {
+    Vector2 center = get_center(entity);
+    s32 cx0 = get_grid_coord(center.x - AI_SEPARATION_RADIUS), cx1 = get_grid_coord(center.x + AI_SEPARATION_RADIUS);
+    s32 cy0 = get_grid_coord(center.y - AI_SEPARATION_RADIUS), cy1 = get_grid_coord(center.y + AI_SEPARATION_RADIUS);
+    u32 query_stamp = ++g_query_stamp;
+    entity->query_stamp = query_stamp;
+
+    f32 separation = 0.f;
+    f32 velocity_sum = 0.f;
+    u32 neighbour_count = 0;
+    u32 scan_count = 0;
+    for(s32 cy = cy0; cy <= cy1; cy++) {
+        for(s32 cx = cx0; cx <= cx1; cx++) {
+            u32 *entries;
+            u32 entry_count = get_grid_cell(grid, cx, cy, &entries);
+            for(u32 i = 0; i < entry_count && neighbour_count < AI_MAX_NEIGHBOURS && scan_count < AI_MAX_NEIGHBOUR_SCAN; i++) {
+                scan_count += 1;
+
+                if(entries[i] >= entity_list->entity_count) continue;
+                Entity *other = &entity_list->entities[entries[i]];
+                if(other->query_stamp == query_stamp || other->ai_state == AI_STATE_NONE) continue;
+                other->query_stamp = query_stamp;
+
+                Vector2 delta = sub_vec2(center, get_center(other));
+                f32 distance = sqrtf(delta.x*delta.x + delta.y*delta.y);
+                if(distance >= AI_SEPARATION_RADIUS) continue;
+
+                // Perfectly stacked enemies split by id
+                f32 dir = (delta.x != 0.f) ? signof(delta.x) : ((entity->id < other->id) ? -1.f : 1.f);
+                separation += dir * (1.f - distance / AI_SEPARATION_RADIUS);
+                velocity_sum += other->velocity.x;
+                neighbour_count += 1;
+            }
+        }
+    }
+
+    if(neighbour_count == 0) return;
+
+    f32 alignment = velocity_sum / neighbour_count - entity->velocity.x;
+    f32 vx = entity->velocity.x + separation * AI_SEPARATION_WEIGHT + alignment * AI_ALIGNMENT_WEIGHT;
+    if(vx > AI_CHASE_SPEED) vx = AI_CHASE_SPEED;
+    if(vx < -AI_CHASE_SPEED) vx = -AI_CHASE_SPEED;
+    entity->velocity.x = vx;
+    g_ai_stats.neighbours += neighbour_count;
+}
+
+// Runs before tick_entities, with the sim tiers it assigned last tick
+static void
+tick_ai(Entity_List *entity_list, Spatial_Grid *grid, Entity *player_entity) {
+    f64 start_time = sys_get_time();
+    u32 tick = g_timers->tick;
+    u32 entity_count = entity_list->entity_count;
+
+    g_ai_stats.decisions = 0;
+    g_ai_stats.neighbours = 0;
+    if(g_ai_cursor >= entity_count) g_ai_cursor = 0;
+
+    u32 scan_count = (entity_count < AI_MAX_SCAN_PER_TICK) ? entity_count : AI_MAX_SCAN_PER_TICK;
+    for(u32 i = 0; i < scan_count && g_ai_stats.decisions < AI_DECISIONS_PER_TICK; i++) {
+        Entity *entity = &entity_list->entities[g_ai_cursor];
+        if(++g_ai_cursor == entity_count) g_ai_cursor = 0;
+
+        if(entity->ai_state == AI_STATE_NONE || entity->sim_tier == SIM_TIER_FROZEN) continue;
+        decide_ai(entity, player_entity, tick);
+        g_ai_stats.decisions += 1;
+    }
+
+    u32 active = 0;
+    for(u32 entity_index = 0; entity_index < entity_count; entity_index++) {
+        Entity *entity = &entity_list->entities[entity_index];
+        if(entity->ai_state == AI_STATE_NONE || entity->sim_tier == SIM_TIER_FROZEN) continue;
+
+        steer_ai(entity, player_entity, tick);
+        if(entity->phys_state == PHYS_STATE_STANDING) {
+            separate_ai(entity, entity_list, grid);
+        }
+        active += 1;
+    }
+
+    g_ai_stats.active = active;
+    g_ai_stats.tick_ms = (f32)((sys_get_time() - start_time) * 1000.0);
+}
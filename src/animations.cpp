@@ -104,35 +104,59 @@ static Anim_Sequence_Def a_sequences[] = {
 struct Anim_Sprite {
     u32 sequence;
     u32 frame_index;
-    f32 timer;
+    Timer_ID timer;
+    u32 owner;
 };
 
+// Defined by the game, resolves the owner and calls advance_anim
+static void anim_timer_proc(u32 owner, u32 tag);
+// Defined by the game, called after a sprite's sequence or frame changes
+static void anim_changed_proc(u32 owner);
+
 static Rectangle 
 get_anim_sprite_rec(Anim_Sprite sprite) {
     return a_sequences[sprite.sequence].frames[sprite.frame_index];
 }
 
+static void
+schedule_anim_frame(Anim_Sprite *sprite) {
+    Anim_Sequence_Def *seq = &a_sequences[sprite->sequence];
+
+    // Single frame looping sequences never change, don't bother the timer wheel
+    if(seq->frame_count > 1 || seq->loop == false) {
+        sprite->timer = add_timer(g_timers, ticks_from_seconds(ANIM_FRAME_RATE), anim_timer_proc, sprite->owner);
+    } else {
+        sprite->timer = 0;
+    }
+}
+
+static void
+stop_anim(Anim_Sprite *sprite) {
+    cancel_timer(g_timers, sprite->timer);
+    sprite->timer = 0;
+}
+
 static void
 play_anim(Anim_Sprite *sprite, u32 sequence) {
     if(sprite->sequence == sequence) return;
 
-    sprite->timer = 0;
+    stop_anim(sprite);
     sprite->sequence = sequence;
     sprite->frame_index = 0;
+    schedule_anim_frame(sprite);
+    anim_changed_proc(sprite->owner);
 }
 
+// Called when the sprite's frame timer expires
 static void
-update_anim(Anim_Sprite *sprite, f32 dt) {
-    sprite->timer += dt;
+advance_anim(Anim_Sprite *sprite) {
+    sprite->timer = 0;
     Anim_Sequence_Def seq = a_sequences[sprite->sequence];
-    if(sprite->timer >= ANIM_FRAME_RATE) {
-        if(sprite->frame_index + 1 >= seq.frame_count && seq.loop == false) {
-            play_anim(sprite, seq.next_seq);
-        } else {
-            sprite->frame_index = (sprite->frame_index + 1) % seq.frame_count;
-            sprite->timer = 0;
-        }
+    if(sprite->frame_index + 1 >= seq.frame_count && seq.loop == false) {
+        play_anim(sprite, seq.next_seq);
+    } else {
+        sprite->frame_index = (sprite->frame_index + 1) % seq.frame_count;
+        schedule_anim_frame(sprite);
+        anim_changed_proc(sprite->owner);
     }
 }
-
-
@@ -0,0 +1,88 @@
+
+// Texture atlas. atlas_builder (src/atlas_builder.cpp) packs the game's images
+// into a few pages ahead of time and writes a rect table, graphics/atlas.txt,
+// with a line per image:
+//
+//   <file name> <page> <x> <y> <width> <height>
+//
+// Images are used as regions, a page texture and the image's rect in it, so
+// sprites, grounds and backgrounds all draw from the same texture and batch
+// together. Rects into an image, like sprite frames, are relative to the
+// image and offset by get_region_rec. Without the table, or for an image
+// missing from it, the image is loaded as its own texture, the region being
+// the whole of it.
+
+static constexpr u32 MAX_ATLAS_PAGES = 4;
+static constexpr u32 MAX_ATLAS_ENTRIES = 64;
+
+struct Texture_Region {
+    Texture2D texture;
+    Rectangle rec;
+};
+
+struct Atlas_Entry {
+    char name[64];
+    u32 page;
+    Rectangle rec;
+};
+
+struct Atlas {
+    u32 page_count;
+    Texture2D pages[MAX_ATLAS_PAGES];
+    u32 entry_count;
+    Atlas_Entry entries[MAX_ATLAS_ENTRIES];
+};
+static Atlas g_atlas;
+
+inline static Rectangle
+get_region_rec(Texture_Region region, Rectangle rec) {
+    return {region.rec.x + rec.x, region.rec.y + rec.y, rec.width, rec.height};
+}
+
+// Pages are dir/atlas_<page>.png. Returns false when there's no table, images
+// are then loaded on their own.
+static bool
+load_atlas(Atlas *atlas, const char *dir) {
+    atlas->page_count = 0;
+    atlas->entry_count = 0;
+
+    char path[256];
+    snprintf(path, sizeof(path), "%s/atlas.txt", dir);
+    FILE *file = fopen(path, "r");
+    if(!file) return false;
+
+    char line[256];
+    while(fgets(line, sizeof(line), file) && atlas->entry_count < MAX_ATLAS_ENTRIES) {
+        Atlas_Entry *entry = &atlas->entries[atlas->entry_count];
+        if(sscanf(line, "%63s %u %f %f %f %f", entry->name, &entry->page, &entry->rec.x, &entry->rec.y,
+                  &entry->rec.width, &entry->rec.height) != 6) continue;
+        if(entry->page >= MAX_ATLAS_PAGES) continue;
+
+        if(entry->page >= atlas->page_count) atlas->page_count = entry->page + 1;
+        atlas->entry_count += 1;
+    }
+    fclose(file);
+
+    for(u32 page = 0; page < atlas->page_count; page++) {
+        snprintf(path, sizeof(path), "%s/atlas_%u.png", dir, page);
+        atlas->pages[page] = g_backend->load_texture(path);
+    }
+    return true;
+}
+
+// path is the image's own file, its file name is the key into the table
+static Texture_Region
+load_texture_region(Atlas *atlas, const char *path) {
+    const char *name = strrchr(path, '/');
+    name = name ? name + 1 : path;
+
+    for(u32 i = 0; i < atlas->entry_count; i++) {
+        Atlas_Entry *entry = &atlas->entries[i];
+        if(strcmp(entry->name, name) == 0) {
+            return {atlas->pages[entry->page], entry->rec};
+        }
+    }
+
+    Texture2D texture = g_backend->load_texture(path);
+    return {texture, {0, 0, (f32)texture.width, (f32)texture.height}};
+}
@@ -0,0 +1,153 @@
+
+// Offline atlas builder, run ahead of time rather than as part of the game:
+//
+//   atlas_builder <out dir> <image>...
+//
+// Packs the images into ATLAS_PAGE_SIZE pages, tallest first on shelves, and
+// writes <out dir>/atlas_<page>.png and the rect table <out dir>/atlas.txt
+// that atlas.cpp reads. Images are keyed by file name, earlier atlas pages
+// passed in by a glob are skipped. Packing is deterministic for the same
+// images in the same order.
+
+#include "common.h"
+#include <cstring>
+#include <cstdlib> // qsort
+#include <raylib.h>
+
+static constexpr u32 MAX_ATLAS_IMAGES = 64;
+static constexpr u32 MAX_ATLAS_PAGES = 4; // Same as the game's
+static constexpr s32 ATLAS_PAGE_SIZE = 2048;
+static constexpr s32 ATLAS_PADDING = 2;
+
+struct Atlas_Image {
+    const char *path;
+    const char *name;
+    Image image;
+    u32 page;
+    s32 x, y;
+};
+
+static Atlas_Image g_images[MAX_ATLAS_IMAGES];
+
+static int
+compare_image_heights(const void *a, const void *b) {
+    const Atlas_Image *ia = *(const Atlas_Image**)a;
+    const Atlas_Image *ib = *(const Atlas_Image**)b;
+    if(ia->image.height != ib->image.height) return ib->image.height - ia->image.height;
+    return strcmp(ia->name, ib->name);
+}
+
+int main(int argc, char **argv) {
+    if(argc < 3) {
+        printf("Usage: atlas_builder <out dir> <image>...\n");
+        return 1;
+    }
+    const char *out_dir = argv[1];
+
+    u32 image_count = 0;
+    for(s32 arg = 2; arg < argc; arg++) {
+        const char *path = argv[arg];
+        const char *name = path;
+        for(const char *c = path; *c; c++) {
+            if(*c == '/' || *c == '\\') name = c + 1;
+        }
+        if(strncmp(name, "atlas_", 6) == 0) continue;
+
+        if(image_count == MAX_ATLAS_IMAGES) {
+            printf("Too many images, skipping %s\n", path);
+            continue;
+        }
+
+        Image image = LoadImage(path);
+        if(!image.data) {
+            printf("Failed to load %s\n", path);
+            continue;
+        }
+        if(image.width + ATLAS_PADDING > ATLAS_PAGE_SIZE || image.height + ATLAS_PADDING > ATLAS_PAGE_SIZE) {
+            printf("%s is larger than a page, skipping\n", path);
+            UnloadImage(image);
+            continue;
+        }
+        ImageFormat(&image, UNCOMPRESSED_R8G8B8A8);
+
+        Atlas_Image *entry = &g_images[image_count++];
+        entry->path = path;
+        entry->name = name;
+        entry->image = image;
+    }
+
+    Atlas_Image *sorted[MAX_ATLAS_IMAGES];
+    for(u32 i = 0; i < image_count; i++) sorted[i] = &g_images[i];
+    qsort(sorted, image_count, sizeof(Atlas_Image*), compare_image_heights);
+
+    // Shelves left to right, top to bottom, a new page when one is full
+    u32 page = 0;
+    s32 shelf_x = 0, shelf_y = 0, shelf_height = 0;
+    s32 page_widths[MAX_ATLAS_PAGES] = {};
+    s32 page_heights[MAX_ATLAS_PAGES] = {};
+    for(u32 i = 0; i < image_count; i++) {
+        Atlas_Image *entry = sorted[i];
+        s32 width = entry->image.width + ATLAS_PADDING;
+        s32 height = entry->image.height + ATLAS_PADDING;
+
+        if(shelf_x + width > ATLAS_PAGE_SIZE) {
+            shelf_x = 0;
+            shelf_y += shelf_height;
+            shelf_height = 0;
+        }
+        if(shelf_y + height > ATLAS_PAGE_SIZE) {
+            page += 1;
+            shelf_x = 0;
+            shelf_y = 0;
+            shelf_height = 0;
+        }
+        if(page == MAX_ATLAS_PAGES) {
+            printf("Out of pages\n");
+            return 1;
+        }
+
+        entry->page = page;
+        entry->x = shelf_x;
+        entry->y = shelf_y;
+        shelf_x += width;
+        if(height > shelf_height) shelf_height = height;
+
+        if(shelf_x > page_widths[page]) page_widths[page] = shelf_x;
+        if(shelf_y + height > page_heights[page]) page_heights[page] = shelf_y + height;
+    }
+    u32 page_count = (image_count > 0) ? page + 1 : 0;
+
+    char path[512];
+    for(u32 p = 0; p < page_count; p++) {
+        Image atlas = GenImageColor(page_widths[p], page_heights[p], BLANK);
+        for(u32 i = 0; i < image_count; i++) {
+            Atlas_Image *entry = &g_images[i];
+            if(entry->page != p) continue;
+            Rectangle src = {0, 0, (f32)entry->image.width, (f32)entry->image.height};
+            ImageDraw(&atlas, entry->image, src, {(f32)entry->x, (f32)entry->y, src.width, src.height}, WHITE);
+        }
+
+        snprintf(path, sizeof(path), "%s/atlas_%u.png", out_dir, p);
+        if(!ExportImage(atlas, path)) {
+            printf("Failed to write %s\n", path);
+            return 1;
+        }
+        UnloadImage(atlas);
+    }
+
+    snprintf(path, sizeof(path), "%s/atlas.txt", out_dir);
+    FILE *file = fopen(path, "w");
+    if(!file) {
+        printf("Failed to write %s\n", path);
+        return 1;
+    }
+    for(u32 i = 0; i < image_count; i++) {
+        Atlas_Image *entry = &g_images[i];
+        fprintf(file, "%s %u %d %d %d %d\n", entry->name, entry->page, entry->x, entry->y, entry->image.width, entry->image.height);
+        UnloadImage(entry->image);
+    }
+    fclose(file);
+
+    printf("Packed %u images into %u pages\n", image_count, page_count);
+    return 0;
+}
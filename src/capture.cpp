@@ -0,0 +1,184 @@
+
+// Frame capture (-capture <path>) for recording gameplay. Each submitted frame
+// is read back into a slot from a ring of CAPTURE_RING_SIZE pooled buffers and
+// handed to a worker thread that writes it out, as a raw Y4M stream when the
+// path ends in .y4m and otherwise as a PNG per frame into the path as a
+// directory, created if it's missing. The main thread never waits on the worker or the disk: when
+// every slot is still waiting to be written the frame is dropped and
+// counted.
+//
+// Two semaphores pass slots back and forth, free counts slots the main thread
+// can fill and filled counts slots the worker can write. The main thread only
+// ever touches write_index and the worker read_index. Stopping waits for
+// every slot to come back, so the worker is idle when told to quit.
+
+static constexpr u32 CAPTURE_RING_SIZE = 8;
+static constexpr u32 CAPTURE_FRAME_RATE = 60;
+
+struct Capture_Slot {
+    u32 frame;
+    Color *pixels;
+};
+
+struct Capture_Stats {
+    u32 captured;
+    u32 dropped;
+};
+static Capture_Stats g_capture_stats; // Published with the simulation thread idle
+
+struct Frame_Capture {
+    bool enabled;
+    bool y4m;
+    const char *path;
+    s32 width, height;
+
+    Capture_Slot slots[CAPTURE_RING_SIZE];
+    u32 write_index;
+    u32 read_index;
+    Sys_Semaphore free;
+    Sys_Semaphore filled;
+    Sys_Thread thread;
+    bool quit;
+
+    // Worker only
+    FILE *file;
+    u8 *planes; // Y4M 4:2:0
+    u32 written;
+    u32 failed;
+
+    u32 frame_count;
+    Capture_Stats stats;
+};
+static Frame_Capture g_capture;
+
+// Full range BT.601, what Y4M's C420jpeg means
+static void
+write_y4m_frame(Frame_Capture *capture, Color *pixels) {
+    s32 width = capture->width;
+    s32 height = capture->height;
+    u8 *y_plane = capture->planes;
+    u8 *u_plane = y_plane + width*height;
+    u8 *v_plane = u_plane + (width/2)*(height/2);
+
+    for(s32 i = 0; i < width*height; i++) {
+        Color c = pixels[i];
+        y_plane[i] = (u8)((77*c.r + 150*c.g + 29*c.b + 128) >> 8);
+    }
+    for(s32 y = 0; y < height/2; y++) {
+        Color *row0 = pixels + (y*2)*width;
+        Color *row1 = row0 + width;
+        for(s32 x = 0; x < width/2; x++) {
+            Color a = row0[x*2], b = row0[x*2 + 1], c = row1[x*2], d = row1[x*2 + 1];
+            s32 r = (a.r + b.r + c.r + d.r + 2) >> 2;
+            s32 g = (a.g + b.g + c.g + d.g + 2) >> 2;
+            s32 bl = (a.b + b.b + c.b + d.b + 2) >> 2;
+            u_plane[y*(width/2) + x] = (u8)(((-43*r - 85*g + 128*bl + 128) >> 8) + 128);
+            v_plane[y*(width/2) + x] = (u8)(((128*r - 107*g - 21*bl + 128) >> 8) + 128);
+        }
+    }
+
+    u32 size = width*height + 2*(width/2)*(height/2);
+    if(fwrite("FRAME\n", 6, 1, capture->file) != 1 || fwrite(capture->planes, size, 1, capture->file) != 1) {
+        capture->failed += 1;
+    }
+}
+
+static void
+capture_thread_proc(void *data) {
+    Frame_Capture *capture = (Frame_Capture*)data;
+    for(;;) {
+        sys_wait_semaphore(&capture->filled);
+        if(capture->quit) break;
+
+        Capture_Slot *slot = &capture->slots[capture->read_index % CAPTURE_RING_SIZE];
+        if(capture->y4m) {
+            write_y4m_frame(capture, slot->pixels);
+        } else {
+            char path[512];
+            snprintf(path, sizeof(path), "%s/frame_%05u.png", capture->path, slot->frame);
+            Image image = {slot->pixels, capture->width, capture->height, 1, UNCOMPRESSED_R8G8B8A8};
+            if(!ExportImage(image, path)) capture->failed += 1;
+        }
+        capture->written += 1;
+
+        capture->read_index += 1;
+        sys_signal_semaphore(&capture->free);
+    }
+}
+
+static bool
+start_frame_capture(Frame_Capture *capture, Allocator *allocator, const char *path, s32 width, s32 height) {
+    u32 length = (u32)strlen(path);
+    capture->y4m = (length >= 4 && strcmp(path + length - 4, ".y4m") == 0);
+    capture->path = path;
+    capture->width = width;
+    capture->height = height;
+
+    if(capture->y4m) {
+        capture->file = fopen(path, "wb");
+        if(!capture->file) return false;
+        fprintf(capture->file, "YUV4MPEG2 W%d H%d F%u:1 Ip A1:1 C420jpeg\n", width, height, CAPTURE_FRAME_RATE);
+        capture->planes = (u8*)alloc_raw(allocator, width*height + 2*(width/2)*(height/2), 64);
+    } else if(!sys_create_directory(path)) {
+        return false;
+    }
+
+    for(u32 i = 0; i < CAPTURE_RING_SIZE; i++) {
+        capture->slots[i].pixels = (Color*)alloc_raw(allocator, sizeof(Color)*width*height, 64);
+    }
+    sys_init_semaphore(&capture->free, CAPTURE_RING_SIZE);
+    sys_init_semaphore(&capture->filled, 0);
+    if(!sys_create_thread(&capture->thread, capture_thread_proc, capture)) {
+        if(capture->file) fclose(capture->file);
+        capture->file = nullptr;
+        return false;
+    }
+
+    capture->enabled = true;
+    return true;
+}
+
+// Call after the frame is drawn and before the backend's end_frame, when the
+// screen still holds it
+static void
+capture_frame(Frame_Capture *capture) {
+    if(!capture->enabled) return;
+
+    u32 frame = capture->frame_count++;
+    if(!sys_try_wait_semaphore(&capture->free)) {
+        capture->stats.dropped += 1;
+        return;
+    }
+
+    Capture_Slot *slot = &capture->slots[capture->write_index % CAPTURE_RING_SIZE];
+    if(!g_backend->read_screen(slot->pixels, capture->width, capture->height)) {
+        sys_signal_semaphore(&capture->free);
+        capture->stats.dropped += 1;
+        return;
+    }
+    slot->frame = frame;
+    capture->write_index += 1;
+    capture->stats.captured += 1;
+    sys_signal_semaphore(&capture->filled);
+}
+
+// Waits for the worker to write what's left
+static void
+stop_frame_capture(Frame_Capture *capture) {
+    if(!capture->enabled) return;
+
+    for(u32 i = 0; i < CAPTURE_RING_SIZE; i++) {
+        sys_wait_semaphore(&capture->free);
+    }
+    capture->quit = true;
+    sys_signal_semaphore(&capture->filled);
+    sys_join_thread(&capture->thread);
+    sys_destroy_semaphore(&capture->free);
+    sys_destroy_semaphore(&capture->filled);
+    if(capture->file) fclose(capture->file);
+    capture->file = nullptr;
+    capture->enabled = false;
+
+    printf("capture: %u frames written to %s, %u dropped, %u failed\n", capture->written, capture->path,
+           capture->stats.dropped, capture->failed);
+}
@@ -0,0 +1,96 @@
+
+// Hits are recorded as damage events while projectiles update and resolved in
+// one pass afterwards. Damage is summed per target first, so a target hit by
+// many projectiles in a tick takes one hp change and at most one death
+// transition, and the explosion sound plays once per tick however many die.
+
+static constexpr u32 MAX_DAMAGE_EVENTS = 64*1024;
+
+struct Damage_Event {
+    Entity_ID target;
+    f32 amount;
+};
+
+struct Damage_Buffer {
+    u32 count;
+    Damage_Event events[MAX_DAMAGE_EVENTS];
+    Entity_ID targets[MAX_DAMAGE_EVENTS]; // Distinct targets, filled while resolving
+};
+static Damage_Buffer *g_damage;
+
+struct Damage_Stats {
+    u32 events;
+    u32 targets;
+    u32 deaths;
+};
+static Damage_Stats g_damage_stats;
+
+static void
+push_damage_event(Damage_Buffer *buffer, Entity *target, f32 amount) {
+    if(target->flags & ENTITY_FLAG_INVULNERABLE) return;
+    if(buffer->count >= MAX_DAMAGE_EVENTS) return;
+
+    buffer->events[buffer->count++] = {target->id, amount};
+}
+
+static void
+kill_entity(Entity *entity) {
+    if(is_terrain(entity)) {
+        mark_terrain_dirty();
+    }
+    entity->flags = entity->flags | (ENTITY_FLAG_INVULNERABLE | ENTITY_FLAG_NO_COLLIDE);
+    entity->phys_state = PHYS_STATE_STATIONARY;
+    entity->collision_rec = {0,0,0,0};
+    entity->velocity = {0,0};
+    entity->ai_state = AI_STATE_NONE;
+    set_entity_ttl(entity, CORPSE_TTL);
+    if(entity->sprite.sequence == ROBOT_STAND) {
+        play_anim(&entity->sprite, ROBOT_BLOWUP);
+    } else if(entity->sprite.sequence == FLOAT_BOT_STAND) {
+        play_anim(&entity->sprite, FLOAT_BOT_BLOWUP);
+    }
+}
+
+static void
+resolve_damage(Damage_Buffer *buffer, Entity_List *entity_list) {
+    u32 target_count = 0;
+
+    for(u32 idx = 0; idx < buffer->count; idx++) {
+        Damage_Event event = buffer->events[idx];
+        if(!has_entity(entity_list, event.target)) continue;
+
+        Entity *entity = get_entity(entity_list, event.target);
+        if(entity->pending_damage == 0.f) {
+            buffer->targets[target_count++] = event.target;
+        }
+        entity->pending_damage += event.amount;
+    }
+
+    u32 death_count = 0;
+    for(u32 idx = 0; idx < target_count; idx++) {
+        Entity *entity = get_entity(entity_list, buffer->targets[idx]);
+        entity->hp -= entity->pending_damage;
+        entity->pending_damage = 0.f;
+
+        if(entity->hp <= 0.f && (entity->flags & ENTITY_FLAG_INVULNERABLE) == 0) {
+            if(entity->flags & ENTITY_FLAG_PLAYER) {
+                // Reloads the level on the next tick boundary, see main
+                g_zone_load = g_current_zone;
+                continue;
+            }
+
+            kill_entity(entity);
+            emit_particle_burst(&g_particles, add_vec2(entity->pos, {16.f, 16.f}), 48, 2.f, 40, {255, 160, 32, 255});
+            death_count += 1;
+        }
+    }
+
+    if(death_count > 0) {
+        play_sound(SOUND_EXPLOSION);
+    }
+
+    g_damage_stats.events = buffer->count;
+    g_damage_stats.targets = target_count;
+    g_damage_stats.deaths = death_count;
+    buffer->count = 0;
+}
@@ -0,0 +1,148 @@
+
+// Debug overlay (F1) and frame pipeline toggles (F2 late latch camera, F3
+// static layer cache, F4 text cache) and the render stats panel (F5,
+// render_stats.cpp).
+//
+// Input latency is measured from the time poll_input sampled an input change
+// to the end of the frame that first simulated it: "submit" is taken right
+// before EndDrawing, "present" right after it returns. raylib waits for the
+// target frame time inside EndDrawing, so present is an upper bound. With the
+// simulation on its own thread a frame is submitted the iteration after it's
+// built, which shows up here.
+
+static constexpr u32 LATENCY_WINDOW = 64;
+
+struct Debug_State {
+    bool overlay;
+    bool late_latch;
+    bool threaded;
+    bool render_stats;
+
+    u32 frame_tick_count;
+    f32 frame_ms;
+    f32 tick_ms; // All of this frame's ticks
+    f32 draw_ms; // Building the render list
+    f32 submit_ms; // Executing it, on the main thread
+    u32 entity_count;
+    u64 mem_used;
+    u64 mem_size;
+
+    f32 submit_latency_ms[LATENCY_WINDOW];
+    f32 present_latency_ms[LATENCY_WINDOW];
+    u32 latency_sample_count;
+};
+static Debug_State g_debug;
+
+static void
+poll_debug_keys() {
+    if(IsKeyPressed(KEY_F1)) g_debug.overlay = !g_debug.overlay;
+    if(IsKeyPressed(KEY_F2)) g_debug.late_latch = !g_debug.late_latch;
+    if(IsKeyPressed(KEY_F3)) g_static_cache.enabled = !g_static_cache.enabled;
+    if(IsKeyPressed(KEY_F4)) g_text_cache.enabled = !g_text_cache.enabled;
+    if(IsKeyPressed(KEY_F5)) g_debug.render_stats = !g_debug.render_stats;
+}
+
+static void
+add_latency_sample(f64 input_time, f64 submit_time, f64 present_time) {
+    u32 slot = g_debug.latency_sample_count++ % LATENCY_WINDOW;
+    g_debug.submit_latency_ms[slot] = (f32)((submit_time - input_time) * 1000.0);
+    g_debug.present_latency_ms[slot] = (f32)((present_time - input_time) * 1000.0);
+}
+
+static void
+get_latency_stats(f32 *samples, f32 *avg, f32 *max) {
+    u32 count = (g_debug.latency_sample_count < LATENCY_WINDOW) ? g_debug.latency_sample_count : LATENCY_WINDOW;
+    *avg = 0.f;
+    *max = 0.f;
+    for(u32 i = 0; i < count; i++) {
+        *avg += samples[i];
+        if(samples[i] > *max) *max = samples[i];
+    }
+    if(count > 0) *avg /= count;
+}
+
+static void
+draw_debug_overlay(Render_List *render) {
+    if(!g_debug.overlay) return;
+
+    char buf[128];
+    s32 x = SCREEN_WIDTH - 360;
+    s32 y = 10;
+
+    push_rect(render, RENDER_LAYER_DEBUG, 0, {(f32)x - 10, 0, 370, 472}, {0,0,0,160});
+
+    snprintf(buf, sizeof(buf), "frame: %.2f ms  ticks: %u", g_debug.frame_ms, g_debug.frame_tick_count);
+    push_text(render, RENDER_LAYER_DEBUG, 1, buf, x, y, 20, WHITE); y += 24;
+
+    snprintf(buf, sizeof(buf), "tick: %.2f  draw: %.2f  submit: %.2f ms", g_debug.tick_ms, g_debug.draw_ms, g_debug.submit_ms);
+    push_text(render, RENDER_LAYER_DEBUG, 1, buf, x, y, 20, WHITE); y += 24;
+
+    snprintf(buf, sizeof(buf), "entities: %u (%u despawned)  mem: %.1f/%.0f MB", g_debug.entity_count, g_despawns.total,
+             g_debug.mem_used / (1024.0 * 1024.0), g_debug.mem_size / (1024.0 * 1024.0));
+    push_text(render, RENDER_LAYER_DEBUG, 1, buf, x, y, 20, WHITE); y += 24;
+
+    snprintf(buf, sizeof(buf), "render: %u items %u batches %.2f ms sort", g_render_stats.items, g_render_stats.batches, g_render_stats.sort_ms);
+    if(g_world_target.enabled) {
+        s32 length = (s32)strlen(buf);
+        f32 resolution = g_render_stats.world_resolution;
+        snprintf(buf + length, sizeof(buf) - length, "  %dx%d", (s32)(g_world_target.target.texture.width * resolution),
+                 (s32)(g_world_target.target.texture.height * resolution));
+        if(g_resolution_governor.enabled) {
+            length = (s32)strlen(buf);
+            snprintf(buf + length, sizeof(buf) - length, " (%.0f%%)", resolution * 100.f);
+        }
+    }
+    push_text(render, RENDER_LAYER_DEBUG, 1, buf, x, y, 20, WHITE); y += 24;
+
+    snprintf(buf, sizeof(buf), "draw: %u drawn %u culled %u visited", g_draw_stats.drawn, g_draw_stats.culled, g_draw_stats.visited);
+    push_text(render, RENDER_LAYER_DEBUG, 1, buf, x, y, 20, WHITE); y += 24;
+
+    snprintf(buf, sizeof(buf), "static (F3): %u tiles %u redraws %u entities %.2f ms", g_static_cache_stats.tiles,
+             g_static_cache_stats.redraws, g_static_cache_stats.entities, g_static_cache_stats.draw_ms);
+    push_text(render, RENDER_LAYER_DEBUG, 1, buf, x, y, 20, WHITE); y += 24;
+
+    snprintf(buf, sizeof(buf), "text (F4): %u hits %u layouts", g_text_cache_stats.hits, g_text_cache_stats.layouts);
+    push_text(render, RENDER_LAYER_DEBUG, 1, buf, x, y, 20, WHITE); y += 24;
+
+    snprintf(buf, sizeof(buf), "sim: %u full %u reduced %u frozen", g_sim_stats.tier_counts[SIM_TIER_FULL],
+             g_sim_stats.tier_counts[SIM_TIER_REDUCED], g_sim_stats.tier_counts[SIM_TIER_FROZEN]);
+    push_text(render, RENDER_LAYER_DEBUG, 1, buf, x, y, 20, WHITE); y += 24;
+
+    snprintf(buf, sizeof(buf), "projectiles: %u  %.2f ms", g_projectiles.count, g_projectile_stats.tick_ms);
+    push_text(render, RENDER_LAYER_DEBUG, 1, buf, x, y, 20, WHITE); y += 24;
+
+    snprintf(buf, sizeof(buf), "particles: %u  %.2f ms tick %.2f ms draw", g_particles.count, g_particle_stats.tick_ms, g_particle_stats.draw_ms);
+    push_text(render, RENDER_LAYER_DEBUG, 1, buf, x, y, 20, WHITE); y += 24;
+
+    snprintf(buf, sizeof(buf), "ai: %u active %u decisions %u shots %.2f ms", g_ai_stats.active, g_ai_stats.decisions, g_ai_stats.shots, g_ai_stats.tick_ms);
+    push_text(render, RENDER_LAYER_DEBUG, 1, buf, x, y, 20, WHITE); y += 24;
+
+    snprintf(buf, sizeof(buf), "crowd: %u neighbours", g_ai_stats.neighbours);
+    push_text(render, RENDER_LAYER_DEBUG, 1, buf, x, y, 20, WHITE); y += 24;
+
+    snprintf(buf, sizeof(buf), "nav: %u nodes %u links %u flows %.2f ms", g_nav->node_count, g_nav->link_count, g_nav_stats.flow_updates, g_nav_stats.flow_ms);
+    push_text(render, RENDER_LAYER_DEBUG, 1, buf, x, y, 20, WHITE); y += 24;
+
+    snprintf(buf, sizeof(buf), "damage: %u hits %u targets %u deaths", g_damage_stats.events, g_damage_stats.targets, g_damage_stats.deaths);
+    push_text(render, RENDER_LAYER_DEBUG, 1, buf, x, y, 20, WHITE); y += 24;
+
+    f32 avg, max;
+    get_latency_stats(g_debug.submit_latency_ms, &avg, &max);
+    snprintf(buf, sizeof(buf), "input->submit: %.1f avg %.1f max", avg, max);
+    push_text(render, RENDER_LAYER_DEBUG, 1, buf, x, y, 20, WHITE); y += 24;
+
+    get_latency_stats(g_debug.present_latency_ms, &avg, &max);
+    snprintf(buf, sizeof(buf), "input->present: %.1f avg %.1f max", avg, max);
+    push_text(render, RENDER_LAYER_DEBUG, 1, buf, x, y, 20, WHITE); y += 24;
+
+    snprintf(buf, sizeof(buf), "late latch camera (F2): %s", g_debug.late_latch ? "on" : "off");
+    push_text(render, RENDER_LAYER_DEBUG, 1, buf, x, y, 20, WHITE); y += 24;
+
+    snprintf(buf, sizeof(buf), "simulation: %s", g_debug.threaded ? "own thread" : "main thread");
+    push_text(render, RENDER_LAYER_DEBUG, 1, buf, x, y, 20, WHITE); y += 24;
+
+    if(g_capture.enabled) {
+        snprintf(buf, sizeof(buf), "capture: %u frames %u dropped", g_capture_stats.captured, g_capture_stats.dropped);
+        push_text(render, RENDER_LAYER_DEBUG, 1, buf, x, y, 20, WHITE); y += 24;
+    }
+}
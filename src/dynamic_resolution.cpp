@@ -0,0 +1,79 @@
+
+// Resolution governor (-dynres). Lowers the fraction of the world target the
+// world is drawn into when frames run over budget and raises it again once
+// there's headroom, in RESOLUTION_STEPS steps between MIN_RESOLUTION_STEP and
+// full. The HUD and other screen layers are always at full resolution.
+//
+// Frame times are smoothed. A frame is over budget by its whole length, so a
+// GPU that can't keep up shows up as missed vsyncs, but headroom is judged on
+// the work alone, the frame less the time end_frame spent, which with vsync
+// is mostly waiting. Hysteresis: lowering takes a smoothed frame time over
+// the budget, raising one well under it for RESOLUTION_RAISE_FRAMES frames in
+// a row, and every change waits RESOLUTION_COOLDOWN_FRAMES for the smoothed
+// times to settle before the next.
+
+static constexpr s32 RESOLUTION_STEPS = 16;
+static constexpr s32 MIN_RESOLUTION_STEP = 8; // Half resolution
+static constexpr f32 RESOLUTION_BUDGET_MS = TIME_STEP * 1000.f;
+static constexpr f32 RESOLUTION_LOWER_RATIO = 1.1f;
+static constexpr f32 RESOLUTION_RAISE_RATIO = 0.7f;
+static constexpr u32 RESOLUTION_RAISE_FRAMES = 60;
+static constexpr u32 RESOLUTION_COOLDOWN_FRAMES = 30;
+static constexpr f32 RESOLUTION_SMOOTHING = 0.1f;
+
+struct Resolution_Governor {
+    bool enabled;
+    s32 step;
+    f32 frame_ms; // Smoothed
+    f32 work_ms;
+    u32 headroom_frames;
+    u32 cooldown;
+    u32 changes;
+};
+static Resolution_Governor g_resolution_governor;
+
+static void
+init_resolution_governor(Resolution_Governor *governor) {
+    *governor = {};
+    governor->enabled = true;
+    governor->step = RESOLUTION_STEPS;
+    governor->frame_ms = RESOLUTION_BUDGET_MS;
+    governor->work_ms = RESOLUTION_BUDGET_MS;
+}
+
+// Once a frame on the main thread, before the next list is executed. The
+// world target has to be enabled.
+static void
+update_resolution_governor(Resolution_Governor *governor, World_Target *world, f32 frame_ms, f32 present_ms) {
+    if(!governor->enabled || !world->enabled) return;
+
+    f32 work_ms = frame_ms - present_ms;
+    governor->frame_ms += (frame_ms - governor->frame_ms) * RESOLUTION_SMOOTHING;
+    governor->work_ms += (work_ms - governor->work_ms) * RESOLUTION_SMOOTHING;
+
+    if(governor->work_ms < RESOLUTION_BUDGET_MS * RESOLUTION_RAISE_RATIO) {
+        governor->headroom_frames += 1;
+    } else {
+        governor->headroom_frames = 0;
+    }
+
+    if(governor->cooldown > 0) {
+        governor->cooldown -= 1;
+        return;
+    }
+
+    s32 step = governor->step;
+    if(governor->frame_ms > RESOLUTION_BUDGET_MS * RESOLUTION_LOWER_RATIO && step > MIN_RESOLUTION_STEP) {
+        step -= 1;
+    } else if(governor->headroom_frames >= RESOLUTION_RAISE_FRAMES && step < RESOLUTION_STEPS) {
+        step += 1;
+    }
+
+    if(step != governor->step) {
+        governor->step = step;
+        governor->headroom_frames = 0;
+        governor->cooldown = RESOLUTION_COOLDOWN_FRAMES;
+        governor->changes += 1;
+        world->resolution = (f32)step / RESOLUTION_STEPS;
+    }
+}
@@ -0,0 +1,163 @@
+
+// Input is sampled from raylib once per rendered frame into a queue of
+// timestamped events, and the simulation consumes it one compact snapshot per
+// tick. The snapshots are all the simulation ever sees, so recording them is
+// enough to replay a session.
+
+enum {
+    INPUT_LEFT = (1<<0),
+    INPUT_RIGHT = (1<<1),
+    INPUT_JUMP = (1<<2),
+    INPUT_INTERACT = (1<<3),
+};
+
+struct Input_Tick {
+    u8 down;
+    u8 pressed;
+    u16 pad;
+    Vector2 mouse; // Screen space
+};
+
+struct Input_Event {
+    f64 time;
+    u8 down;
+    u8 pressed;
+    Vector2 mouse;
+};
+
+static constexpr u32 MAX_INPUT_EVENTS = 256;
+static constexpr u32 INPUT_FILE_MAGIC = 0x4e49444c; // "LDIN"
+static constexpr u32 INPUT_FILE_VERSION = 1;
+
+struct Input_Queue {
+    Input_Event events[MAX_INPUT_EVENTS];
+    u32 head;
+    u32 count;
+    Input_Tick held; // State after the last consumed event
+    f64 unreported_time; // Oldest consumed event whose frame hasn't been presented, 0 if none
+};
+
+struct Input_Recording {
+    Input_Tick *ticks;
+    u32 tick_count;
+    u32 max_tick_count;
+    u32 cursor; // Next tick to replay
+    u64 seed;
+};
+
+static void
+push_input_event(Input_Queue *queue, Input_Event event) {
+    if(queue->count == MAX_INPUT_EVENTS) {
+        // Drop the oldest event but keep its presses so they aren't lost
+        Input_Event *oldest = &queue->events[queue->head];
+        queue->head = (queue->head + 1) % MAX_INPUT_EVENTS;
+        queue->count -= 1;
+        queue->events[queue->head].pressed |= oldest->pressed;
+    }
+
+    queue->events[(queue->head + queue->count) % MAX_INPUT_EVENTS] = event;
+    queue->count += 1;
+}
+
+// The only place the game reads raylib's keyboard and mouse state
+static void
+poll_input(Input_Queue *queue, f64 time) {
+    Input_Event event = {};
+    event.time = time;
+    event.mouse = GetMousePosition();
+
+    if(IsKeyDown(KEY_A)) event.down |= INPUT_LEFT;
+    if(IsKeyDown(KEY_D)) event.down |= INPUT_RIGHT;
+    if(IsKeyDown(KEY_SPACE)) event.down |= INPUT_JUMP;
+    if(IsKeyPressed(KEY_SPACE)) event.pressed |= INPUT_JUMP;
+
+    if(!(IsKeyPressed(KEY_A) && IsKeyPressed(KEY_D)) && (IsKeyPressed(KEY_E) || IsMouseButtonPressed(MOUSE_LEFT_BUTTON))) {
+        event.pressed |= INPUT_INTERACT;
+    }
+
+    // Only changes are queued, the mouse rides along with them
+    u8 last_down = queue->held.down;
+    if(queue->count > 0) {
+        last_down = queue->events[(queue->head + queue->count - 1) % MAX_INPUT_EVENTS].down;
+    }
+
+    if(event.down != last_down || event.pressed) {
+        push_input_event(queue, event);
+    } else if(queue->count == 0) {
+        queue->held.mouse = event.mouse;
+    }
+}
+
+// Builds the snapshot for one simulation tick. Each tick consumes queued
+// events up to and including the next one with a press, so presses from frames
+// that ran no ticks are neither lost nor merged.
+static Input_Tick
+next_input_tick(Input_Queue *queue) {
+    Input_Tick result = queue->held;
+    result.pressed = 0;
+
+    while(queue->count > 0) {
+        Input_Event *event = &queue->events[queue->head];
+        queue->head = (queue->head + 1) % MAX_INPUT_EVENTS;
+        queue->count -= 1;
+
+        if(queue->unreported_time == 0.0) queue->unreported_time = event->time;
+        result.down = event->down;
+        result.mouse = event->mouse;
+        result.pressed |= event->pressed;
+        if(event->pressed) break;
+    }
+
+    queue->held = result;
+    queue->held.pressed = 0;
+    return result;
+}
+
+static void
+record_input_tick(Input_Recording *recording, Input_Tick input) {
+    if(recording->tick_count < recording->max_tick_count) {
+        recording->ticks[recording->tick_count++] = input;
+    }
+}
+
+static bool
+replay_input_tick(Input_Recording *recording, Input_Tick *input) {
+    if(recording->cursor >= recording->tick_count) return false;
+    *input = recording->ticks[recording->cursor++];
+    return true;
+}
+
+static bool
+save_input_recording(Input_Recording *recording, const char *path) {
+    FILE *file = fopen(path, "wb");
+    if(!file) return false;
+
+    u32 header[2] = {INPUT_FILE_MAGIC, INPUT_FILE_VERSION};
+    fwrite(header, sizeof(header), 1, file);
+    fwrite(&recording->seed, sizeof(recording->seed), 1, file);
+    fwrite(&recording->tick_count, sizeof(recording->tick_count), 1, file);
+    fwrite(recording->ticks, sizeof(Input_Tick), recording->tick_count, file);
+    fclose(file);
+    return true;
+}
+
+static bool
+load_input_recording(Input_Recording *recording, const char *path) {
+    FILE *file = fopen(path, "rb");
+    if(!file) return false;
+
+    u32 header[2] = {};
+    u32 tick_count = 0;
+    bool ok = (fread(header, sizeof(header), 1, file) == 1 &&
+               header[0] == INPUT_FILE_MAGIC && header[1] == INPUT_FILE_VERSION &&
+               fread(&recording->seed, sizeof(recording->seed), 1, file) == 1 &&
+               fread(&tick_count, sizeof(tick_count), 1, file) == 1 &&
+               tick_count <= recording->max_tick_count);
+    if(ok) {
+        recording->tick_count = (u32)fread(recording->ticks, sizeof(Input_Tick), tick_count, file);
+        recording->cursor = 0;
+    }
+
+    fclose(file);
+    return ok;
+}
@@ -1,6 +1,7 @@
 #include "common.h"
 #include <cmath>
 #include <cstring> // memset
+#include <cstdlib> // qsort
 #include <raylib.h>
 
 #ifdef PLATFORM_LINUX
@@ -13,12 +14,20 @@ static constexpr f32 TIME_STEP = 1.f/60.f;
 static constexpr s32 SCREEN_WIDTH = 1280;
 static constexpr s32 SCREEN_HEIGHT = 720;
 static constexpr f32 TERMINAL_VELOCITY = 4.f;
-static constexpr s32 MAX_PROJECTILE_COUNT = 25;
 static constexpr f32 ANIM_FRAME_RATE = 1.f/8.f;
 
 #include "utils.cpp"
+#include "timers.cpp"
 #include "animations.cpp"
 #include "dialogs.cpp"
+#include "input.cpp"
+#include "render_backend.cpp"
+#include "soft_renderer.cpp"
+#include "capture.cpp"
+#include "render.cpp"
+#include "text_cache.cpp"
+#include "atlas.cpp"
+#include "dynamic_resolution.cpp"
 
 static Rand_State g_rand_state;
 static s32 g_zone_load = -1;
@@ -36,6 +45,12 @@ enum {
 
 static Sound g_sounds[SOUND_COUNT];
 
+// Sounds are queued on the frame being built and started when it's submitted
+static void
+play_sound(u8 sound) {
+    push_sound(g_frame_render, sound);
+}
+
 enum {
     ITEM_NONE,
     ITEM_PISTOL,
@@ -78,17 +93,18 @@ enum {
     ENTITY_FLAG_CORPO = (1<<7),
 };
 
+enum {
+    AI_STATE_NONE, // Not driven by the AI
+    AI_STATE_IDLE, // Hasn't made its first decision
+    AI_STATE_PATROL,
+    AI_STATE_CHASE,
+    AI_STATE_SHOOT,
+};
+
 typedef u32 Entity_ID;
 struct Entity;
 typedef void (*Entity_Interact_Proc)(Entity *entity, Entity *other, u8 interact_state);
 
-struct Projectile {
-    Vector2 dir;
-    Vector2 pos;
-    f32 lifetime;
-    Entity_ID shooter;
-};
-
 struct Entity {
     Entity_ID id;
     u32 flags;
@@ -99,11 +115,24 @@ struct Entity {
     Color color;
 
     Anim_Sprite sprite;
+    Timer_ID ttl_timer; // Despawns the entity when it fires
 
     f32 hp;
+    f32 pending_damage;
 
     Rectangle collision_rec;
-    Entity *last_ground;
+    Entity_ID ground;
+
+    u8 sim_tier;
+    u32 sim_tick;
+    u32 query_stamp; // Last grid query that visited this entity
+    bool static_cached; // Drawn from the static layer cache instead of each frame
+
+    u8 ai_state;
+    f32 ai_dir; // Patrol or chase direction, -1 or 1
+    f32 ai_home_x;
+    f32 ai_target_x;
+    u32 ai_next_shot;
 
     f32 interact_radius;
     u8 interact_state;
@@ -118,29 +147,6 @@ get_bounds(Entity *entity) {
     return {entity->pos.x + entity->collision_rec.x, entity->pos.y + entity->collision_rec.y, entity->collision_rec.width, entity->collision_rec.height};
 }
 
-static void
-apply_velocity(Entity *entity) {
-    entity->pos = add_vec2(entity->pos, mul_vec2_f(entity->velocity, 2.f));
-    Vector2 entity_col_circle = add_vec2(entity->pos, {16.f, 32.f});
-
-    if(is_falling(entity->phys_state) && entity->velocity.y < TERMINAL_VELOCITY) {
-        entity->velocity.y += 0.15f;
-
-        if(entity->velocity.y >= 0.f) { 
-            entity->phys_state = PHYS_STATE_FALLING;
-        }
-    } else {
-        if(entity->last_ground) {
-            Rectangle ground_bounds = get_bounds(entity->last_ground);
-            if(!CheckCollisionCircleRec(entity_col_circle, 1.f, ground_bounds)) {
-                entity->phys_state = PHYS_STATE_FALLING;
-                entity->last_ground = nullptr;
-            }
-        }
-    }
-
-}
-
 static bool
 in_dialog(Entity *player_entity) {
     return (player_entity->dialog.id >= 0);
@@ -156,9 +162,10 @@ continue_dialog(Entity *player_entity) {
     }
 }
 
+// Indices are u16 with UINT16_MAX marking a free slot, so one less entity fits
 static constexpr s32 MAX_ENTITY_COUNT = 64*1024;
-#define INDEX_MASK 0xfff
-#define NEW_ENTITY_ID_ADD 0x1000
+#define INDEX_MASK 0xffff
+#define NEW_ENTITY_ID_ADD 0x10000
 
 struct Entity_Index {
     u32 id;
@@ -175,6 +182,14 @@ struct Entity_List {
 };
 static Entity_List *g_entity_list;
 
+#include "physics.cpp"
+#include "spatial.cpp"
+#include "nav.cpp"
+
+// Defined in static_layer.cpp
+static void mark_static_cache_dirty();
+static void mark_static_entity_dirty(Entity *entity);
+
 static void
 init_entity_list(Entity_List *entity_list) {
     entity_list->entity_count = 0;
@@ -183,6 +198,10 @@ init_entity_list(Entity_List *entity_list) {
         entity_list->indices[i].next = i + 1;
     }
     memset(entity_list->entities, 0, sizeof(Entity)*MAX_ENTITY_COUNT);
+    clear_timers(g_timers);
+    mark_terrain_dirty();
+    mark_nav_dirty();
+    mark_static_cache_dirty();
     entity_list->freelist_dequeue = 0;
     entity_list->freelist_enqueue = MAX_ENTITY_COUNT - 1;
 }
@@ -200,13 +219,18 @@ get_entity(Entity_List *entity_list, Entity_ID id) {
 
 inline static Entity_ID
 add_entity(Entity_List *entity_list) {
+    d_assert(entity_list->entity_count < MAX_ENTITY_COUNT - 1);
     Entity_Index *in = &entity_list->indices[entity_list->freelist_dequeue];
     entity_list->freelist_dequeue = in->next;
     in->id += NEW_ENTITY_ID_ADD;
     in->index = entity_list->entity_count++;
 
     Entity *entity = &entity_list->entities[in->index];
+    *entity = {};
     entity->id = in->id;
+    entity->sprite.owner = in->id;
+    // New movers take a single step on their first tick
+    entity->sim_tick = g_timers->tick;
     return entity->id;
 }
 
@@ -215,6 +239,14 @@ remove_entity(Entity_List *entity_list, Entity_ID id) {
     Entity_Index *in = &entity_list->indices[id & INDEX_MASK];
 
     Entity &entity = entity_list->entities[in->index];
+    stop_anim(&entity.sprite);
+    cancel_timer(g_timers, entity.ttl_timer);
+    if(entity.static_cached) {
+        mark_static_entity_dirty(&entity);
+    }
+    if(is_terrain(&entity)) {
+        mark_terrain_dirty();
+    }
     entity = entity_list->entities[--entity_list->entity_count];
     entity_list->indices[entity.id & INDEX_MASK].index = in->index;
 
@@ -223,6 +255,50 @@ remove_entity(Entity_List *entity_list, Entity_ID id) {
     entity_list->freelist_enqueue = id & INDEX_MASK;
 }
 
+// Entities given a time to live are despawned by a timer on the wheel, so
+// nothing checks ages per tick. The timer only queues the entity, queued
+// entities are removed in one batch after the tick's timers have run.
+static constexpr u32 MAX_DESPAWN_QUEUE = 4096;
+static constexpr f32 ITEM_DROP_TTL = 30.f;
+static constexpr f32 CORPSE_TTL = 10.f;
+
+struct Despawn_Queue {
+    u32 count;
+    u32 total; // Since startup
+    Entity_ID ids[MAX_DESPAWN_QUEUE];
+};
+static Despawn_Queue g_despawns;
+
+static void
+despawn_timer_proc(u32 owner, u32 tag) {
+    if(!has_entity(g_entity_list, owner)) return;
+
+    Entity *entity = get_entity(g_entity_list, owner);
+    if(g_despawns.count < MAX_DESPAWN_QUEUE) {
+        g_despawns.ids[g_despawns.count++] = owner;
+        entity->ttl_timer = 0;
+    } else {
+        entity->ttl_timer = add_timer(g_timers, 1, despawn_timer_proc, owner);
+    }
+}
+
+static void
+set_entity_ttl(Entity *entity, f32 seconds) {
+    cancel_timer(g_timers, entity->ttl_timer);
+    entity->ttl_timer = add_timer(g_timers, ticks_from_seconds(seconds), despawn_timer_proc, entity->id);
+}
+
+static void
+flush_despawns(Despawn_Queue *queue, Entity_List *entity_list) {
+    for(u32 idx = 0; idx < queue->count; idx++) {
+        if(has_entity(entity_list, queue->ids[idx])) {
+            remove_entity(entity_list, queue->ids[idx]);
+        }
+    }
+    queue->total += queue->count;
+    queue->count = 0;
+}
+
 static Entity_ID 
 add_player_entity(Entity_List *entity_list) {
     Entity_ID player_entity_id = add_entity(entity_list);
@@ -232,11 +308,9 @@ add_player_entity(Entity_List *entity_list) {
     player_entity->collision_rec = {9,0, 12, 32};
     player_entity->velocity = {0,0};
     player_entity->phys_state = PHYS_STATE_FALLING;
-    player_entity->last_ground = nullptr;
     player_entity->color = BLUE;
     player_entity->hp = 100.f;
-    player_entity->sprite = {};
-    player_entity->sprite.sequence = PLAYER_STAND_RIGHT;
+    play_anim(&player_entity->sprite, PLAYER_STAND_RIGHT);
     player_entity->dialog.id = -1;
 
     return player_entity_id;
@@ -252,19 +326,18 @@ add_enemy_entity(Entity_List *entity_list, u32 level, u32 type) {
     entity->collision_rec = {6, 0, 18, 32};
     entity->velocity = {0,0};
     entity->phys_state = PHYS_STATE_FALLING;
-    entity->last_ground = nullptr;
     entity->color = RED;
-    entity->sprite = {};
     entity->on_interact = nullptr;
+    entity->ai_state = AI_STATE_IDLE;
 
     switch(type) {
         case 0: {
             entity->hp = 100.f;
-            entity->sprite.sequence = ROBOT_STAND;
+            play_anim(&entity->sprite, ROBOT_STAND);
         } break;
         case 1: {
             entity->hp = 25.f;
-            entity->sprite.sequence = FLOAT_BOT_STAND;
+            play_anim(&entity->sprite, FLOAT_BOT_STAND);
         } break;
     };
 
@@ -277,10 +350,11 @@ npc_on_interact(Entity *entity, Entity *other, u8 interact_state) {
         entity->interact_state = INTERACT_STATE_TRIGGERED;
         entity->flags |= ENTITY_FLAG_NO_COLLIDE;
         entity->phys_state = PHYS_STATE_STATIONARY;
+        mark_terrain_dirty();
         other->dialog.id = entity->dialog.id;
         other->dialog.line = 0;
         other->dialog.giver = entity;
-        PlaySound(g_sounds[SOUND_ROBOT]);
+        play_sound(SOUND_ROBOT);
     } 
 }
 
@@ -290,6 +364,7 @@ dekard_on_interact(Entity *entity, Entity *other, u8 interact_state) {
         entity->interact_state = INTERACT_STATE_TRIGGERED;
         entity->flags |= ENTITY_FLAG_NO_COLLIDE;
         entity->phys_state = PHYS_STATE_STATIONARY;
+        mark_terrain_dirty();
         other->dialog.id = entity->dialog.id;
         other->dialog.line = 0;
         other->dialog.giver = entity;
@@ -310,11 +385,9 @@ add_npc_entity(Entity_List *entity_list) {
     entity->collision_rec = {6, 0, 18, 32};
     entity->velocity = {0,0};
     entity->phys_state = PHYS_STATE_FALLING;
-    entity->last_ground = nullptr;
     entity->color = RED;
     entity->hp = 100.f;
-    entity->sprite = {};
-    entity->sprite.sequence = ROBOT_STAND;
+    play_anim(&entity->sprite, ROBOT_STAND);
     entity->interact_radius = 16.f;
     //entity->on_interact = npc_on_interact;
 
@@ -325,14 +398,14 @@ static void
 door_zone_2_open(Entity *entity, Entity *other, u8 interact_state) {
     if(interact_state == INTERACT_STATE_TRIGGERED) {
         g_zone_load = 2;
-        PlaySound(g_sounds[SOUND_DOOR]);
+        play_sound(SOUND_DOOR);
     }
 }
 
 static void
 dungeon_door_open(Entity *entity, Entity *other, u8 interact_state) {
     if(interact_state == INTERACT_STATE_TRIGGERED) {
-        PlaySound(g_sounds[SOUND_DUNGEON_DOOR]);
+        play_sound(SOUND_DUNGEON_DOOR);
         g_zone_load = g_current_zone + 1; 
     }
 }
@@ -342,8 +415,9 @@ door_on_interact(Entity *entity, Entity *other, u8 interact_state) {
     if(entity->interact_state != INTERACT_STATE_TRIGGERED && interact_state == INTERACT_STATE_TRIGGERED) {
         entity->interact_state = INTERACT_STATE_TRIGGERED;
         entity->flags |= ENTITY_FLAG_NO_COLLIDE;
+        mark_terrain_dirty();
         play_anim(&entity->sprite, BIG_DOOR_OPENING);
-        PlaySound(g_sounds[SOUND_DOOR]);
+        play_sound(SOUND_DOOR);
     }
 }
 
@@ -355,8 +429,7 @@ add_big_door_entity(Entity_List *entity_list, bool unlockable) {
     entity->pos = {0, 0};
     entity->collision_rec = {28, 32, 8, 32};
     entity->phys_state = PHYS_STATE_STATIONARY;
-    entity->sprite = {};
-    entity->sprite.sequence = BIG_DOOR_CLOSED;
+    play_anim(&entity->sprite, BIG_DOOR_CLOSED);
     entity->interact_radius = 24.f;
 
     if(unlockable) {
@@ -376,8 +449,7 @@ add_building_entity(Entity_List *entity_list, u32 building_id) {
     entity->pos = {0, 0};
     entity->collision_rec = {32, 48, 32, 32};
     entity->phys_state = PHYS_STATE_STATIONARY;
-    entity->sprite = {};
-    entity->sprite.sequence = building_id;
+    play_anim(&entity->sprite, building_id);
     entity->interact_radius = 8.f;
 
     return entity;
@@ -393,6 +465,7 @@ add_ground_entity(Entity_List *entity_list) {
     entity->phys_state = PHYS_STATE_STATIONARY;
     entity->flags = ENTITY_FLAG_INVULNERABLE | ENTITY_FLAG_GROUND;
     entity->color = WHITE;
+    entity->static_cached = true;
     
     return entity;
 }
@@ -407,8 +480,8 @@ add_item_drop_entity(Entity_List *entity_list, u32 item_id) {
     drop->collision_rec = {0,0, 16, 16};
     drop->velocity = {0,-2.f};
     drop->phys_state = PHYS_STATE_FALLING;
-    drop->last_ground = nullptr;
-    drop->sprite.sequence = item_id;
+    play_anim(&drop->sprite, item_id);
+    set_entity_ttl(drop, ITEM_DROP_TTL);
 
     return drop;
 
@@ -427,7 +500,7 @@ lootbox_on_interact(Entity *entity, Entity *other, u8 interact_state) {
             play_anim(&entity->sprite, LOOTBOX_OPEN);
             Entity *item = add_item_drop_entity(g_entity_list, GUN);
             item->pos = add_vec2(entity->pos, {8.f, -32.f});
-            PlaySound(g_sounds[SOUND_DUNGEON_DOOR]);
+            play_sound(SOUND_DUNGEON_DOOR);
         } else if(interact_state == INTERACT_STATE_NONE && entity->interact_state == INTERACT_STATE_NEAR) {
             entity->interact_state = INTERACT_STATE_NONE;
             play_anim(&entity->sprite, LOOTBOX);
@@ -445,65 +518,170 @@ add_lootbox_entity(Entity_List *entity_list) {
     entity->collision_rec = {0, 0, 32,32};
     entity->phys_state = PHYS_STATE_STATIONARY;
     entity->color = WHITE;
-    entity->sprite = {};
-    entity->sprite.sequence = LOOTBOX;
+    play_anim(&entity->sprite, LOOTBOX);
     entity->on_interact = lootbox_on_interact;
     entity->interact_radius = 16.f;
     
     return entity;
 }
 
-struct World { 
-    Projectile *projctiles;
-    s32 projectile_count;
+static void
+anim_timer_proc(u32 owner, u32 tag) {
+    if(has_entity(g_entity_list, owner)) {
+        advance_anim(&get_entity(g_entity_list, owner)->sprite);
+    }
+}
+
+// Stationary entities showing a frame that won't change are drawn from the
+// static layer cache
+static void
+anim_changed_proc(u32 owner) {
+    if(!has_entity(g_entity_list, owner)) return;
+
+    Entity *entity = get_entity(g_entity_list, owner);
+    bool cached = (entity->phys_state == PHYS_STATE_STATIONARY && entity->sprite.timer == 0);
+    if(cached || entity->static_cached) {
+        mark_static_entity_dirty(entity);
+    }
+    entity->static_cached = cached;
+}
+
+static constexpr s32 MAX_TICK_REMOVALS = 256;
+static constexpr f32 GRID_QUERY_SLOP = 16.f; // More than any mover covers per step, reduced movers take several
+static u32 g_query_stamp; // Bumped by every grid query that marks Entity::query_stamp
+
+// Simulation level of detail. Movers near the camera run every tick, the ones
+// further out every SIM_REDUCED_STRIDE ticks (catching up on the skipped time)
+// and anything past SIM_ACTIVE_DISTANCE is frozen, animation included.
+enum {
+    SIM_TIER_FULL,
+    SIM_TIER_REDUCED,
+    SIM_TIER_FROZEN,
+    SIM_TIER_COUNT
 };
 
-static bool
-is_interact_key() { return (!(IsKeyPressed(KEY_A) && IsKeyPressed(KEY_D)) && (IsKeyPressed(KEY_E) || IsMouseButtonPressed(MOUSE_LEFT_BUTTON))); }
+static constexpr f32 SIM_FULL_MARGIN = 64.f;
+static constexpr f32 SIM_ACTIVE_DISTANCE = 1024.f;
+static constexpr u32 SIM_REDUCED_STRIDE = 4;
+
+struct Sim_Stats {
+    u32 tier_counts[SIM_TIER_COUNT];
+};
+static Sim_Stats g_sim_stats;
+
+static u8
+get_sim_tier(Entity *entity, Rectangle full_rec, Rectangle active_rec) {
+    if(entity->flags & ENTITY_FLAG_PLAYER) return SIM_TIER_FULL;
+
+    Rectangle bounds = get_bounds(entity);
+    if(CheckCollisionRecs(bounds, full_rec)) return SIM_TIER_FULL;
+    if(CheckCollisionRecs(bounds, active_rec)) return SIM_TIER_REDUCED;
+    return SIM_TIER_FROZEN;
+}
 
 static void 
-tick_entities(Entity_List *entity_list) {
+tick_entities(Entity_List *entity_list, Spatial_Grid *grid, Rectangle view, Input_Tick *input) {
+    if(g_terrain->dirty) {
+        build_terrain(g_terrain, entity_list);
+    }
+    build_spatial_grid(grid, entity_list);
+
+    Entity_ID removals[MAX_TICK_REMOVALS];
+    s32 removal_count = 0;
+
+    // The timer wheel tick doubles as the simulation tick
+    u32 tick = g_timers->tick;
+    Rectangle full_rec = expand_rec(view, SIM_FULL_MARGIN);
+    Rectangle active_rec = expand_rec(full_rec, SIM_ACTIVE_DISTANCE);
+    g_sim_stats = {};
+    u32 max_steps = 1; // Most steps any mover has taken so far this tick
 
     for(s32 entity_index = 0; entity_index < entity_list->entity_count; entity_index++) {
         Entity *entity = &entity_list->entities[entity_index];
 
         if(entity->phys_state != PHYS_STATE_STATIONARY) { 
-            apply_velocity(entity);            
+            u8 tier = get_sim_tier(entity, full_rec, active_rec);
+            g_sim_stats.tier_counts[tier] += 1;
+
+            if(tier != entity->sim_tier) {
+                // Frozen movers don't animate, restart the frame timer when they thaw
+                if(tier == SIM_TIER_FROZEN) {
+                    stop_anim(&entity->sprite);
+                } else if(entity->sim_tier == SIM_TIER_FROZEN && entity->sprite.timer == 0) {
+                    schedule_anim_frame(&entity->sprite);
+                }
+                entity->sim_tier = tier;
+            }
+
+            if(tier == SIM_TIER_FROZEN) continue;
+            if(tier == SIM_TIER_REDUCED && ((tick + entity->id) % SIM_REDUCED_STRIDE) != 0) continue;
+
+            // Time spent frozen is not replayed, at most one reduced stride is
+            u32 steps = tick - entity->sim_tick;
+            if(steps < 1) steps = 1;
+            if(steps > SIM_REDUCED_STRIDE) steps = SIM_REDUCED_STRIDE;
+            entity->sim_tick = tick;
+            if(steps > max_steps) max_steps = steps;
+
+            move_kinematic(g_terrain, entity, steps);
         
+            // The grid holds where entities were at the start of the tick, widen
+            // the query by how far they can have moved since, this one and any
+            // moved before it, up to SIM_REDUCED_STRIDE steps each
             Rectangle bounds = get_bounds(entity);
-            for(s32 other_entity_idx = 0; other_entity_idx < entity_list->entity_count; other_entity_idx++) {
-                if(other_entity_idx == entity_index) continue; // @Optimize by folding this into the for loop
+            Rectangle query = expand_rec(bounds, GRID_QUERY_SLOP * max_steps);
+            s32 cx0 = get_grid_coord(query.x), cx1 = get_grid_coord(query.x + query.width);
+            s32 cy0 = get_grid_coord(query.y), cy1 = get_grid_coord(query.y + query.height);
+            u32 query_stamp = ++g_query_stamp;
+            entity->query_stamp = query_stamp;
 
-                Entity *other = &entity_list->entities[other_entity_idx];
-                Rectangle other_bounds = get_bounds(other);
+            for(s32 cy = cy0; cy <= cy1; cy++) {
+                for(s32 cx = cx0; cx <= cx1; cx++) {
+                    u32 *entries;
+                    u32 entry_count = get_grid_cell(grid, cx, cy, &entries);
+                    for(u32 i = 0; i < entry_count; i++) {
+                        Entity *other = &entity_list->entities[entries[i]];
+
+                        // Big entities are listed in several cells
+                        if(other->query_stamp == query_stamp) continue;
+                        other->query_stamp = query_stamp;
+
+                        // Terrain was already resolved by the sweep
+                        if((other->flags & ENTITY_FLAG_NO_COLLIDE) || is_terrain(other)) continue;
+
+                        Rectangle other_bounds = get_bounds(other);
+                        if(!CheckCollisionRecs(bounds, other_bounds)) continue;
 
-                if((other->flags & ENTITY_FLAG_NO_COLLIDE) == 0) {
-                    
-                    if(CheckCollisionRecs(bounds, other_bounds)) {
                         if(other->flags & ENTITY_FLAG_PICKUP) {
-                            remove_entity(entity_list, other->id);
-                            PlaySound(g_sounds[SOUND_PICKUP]);
+                            if((entity->flags & ENTITY_FLAG_PLAYER) && removal_count < MAX_TICK_REMOVALS) {
+                                other->flags = (other->flags & ~ENTITY_FLAG_PICKUP) | ENTITY_FLAG_NO_COLLIDE;
+                                removals[removal_count++] = other->id;
+                                play_sound(SOUND_PICKUP);
+                            }
                             continue;
                         }
+
+                        // Movers don't stand on each other, just slide apart without entering terrain
                         Rectangle col_rect = GetCollisionRec(bounds, other_bounds);
-                        Vector2 entity_col_circle = add_vec2(entity->pos, {16.f, 32.f});
-
-                        if(entity->phys_state == PHYS_STATE_FALLING && CheckCollisionCircleRec(entity_col_circle, 2.f, other_bounds)) {
-                            entity->velocity.y = 0.f;
-                            entity->pos.y -= col_rect.height;
-                            entity->phys_state = PHYS_STATE_STANDING;
-                            entity->last_ground = other;
-                        } else {
-                            entity->pos.x += signof(entity->pos.x - other_bounds.x) * col_rect.width;
-                            entity->velocity.x = 0.f;
-                        }
+                        f32 push = sweep_x(g_terrain, bounds, signof(entity->pos.x - other_bounds.x) * col_rect.width, nullptr);
+                        entity->pos.x += push;
+                        entity->velocity.x = 0.f;
+                        bounds.x += push;
                     }
-                } 
-               
-                if(entity->flags & ENTITY_FLAG_PLAYER && other->flags & ENTITY_FLAG_INTERACTABLE) {
+                }
+            }
+
+            // Interactables are few and need to hear when the player leaves, so they're checked without the grid
+            if((entity->flags & ENTITY_FLAG_PLAYER) == 0) continue;
+
+            for(s32 other_entity_idx = 0; other_entity_idx < entity_list->entity_count; other_entity_idx++) {
+                Entity *other = &entity_list->entities[other_entity_idx];
+                Rectangle other_bounds = get_bounds(other);
+
+                if(other->flags & ENTITY_FLAG_INTERACTABLE) {
                     if(CheckCollisionCircleRec({other_bounds.x, other_bounds.y}, other->interact_radius, bounds)) {
                         if(other->on_interact) {
-                            u8 interact_state = (is_interact_key() && fabsf(entity->velocity.x) == 0) ? INTERACT_STATE_TRIGGERED : INTERACT_STATE_NEAR;
+                            u8 interact_state = ((input->pressed & INPUT_INTERACT) && fabsf(entity->velocity.x) == 0) ? INTERACT_STATE_TRIGGERED : INTERACT_STATE_NEAR;
                             other->on_interact(other, entity, interact_state);
                         }
                     } else {
@@ -517,40 +695,144 @@ tick_entities(Entity_List *entity_list) {
 
             
         } // not stationary
+    } // for each entity
 
+    // Removing while iterating would swap entities out from under the loop
+    for(s32 idx = 0; idx < removal_count; idx++) {
+        remove_entity(entity_list, removals[idx]);
+    }
+}
 
-        update_anim(&entity->sprite, TIME_STEP);
-    } // for each entity
+static Texture_Region t_sprites;
+static Texture_Region t_bg;
+static Texture_Region t_ground;
+
+static constexpr Rectangle SPRITE_CURSOR_REC = {448, 0, 32, 32};
 
+// Every zone's art is loaded up front, zones are built on the simulation
+// thread which can't touch the renderer
+enum {
+    ZONE_ART_DESERT,
+    ZONE_ART_INDOOR,
+    ZONE_ART_CYBERPINK,
+    ZONE_ART_COUNT
+};
+static Texture_Region t_zone_bgs[ZONE_ART_COUNT];
+static Texture_Region t_zone_grounds[ZONE_ART_COUNT];
+
+static void
+set_zone_art(u32 art) {
+    t_bg = t_zone_bgs[art];
+    t_ground = t_zone_grounds[art];
 }
 
-static Texture2D t_sprites;
-static Texture2D t_bg;
-static Texture2D t_ground;
+static constexpr f32 GROUND_REPEAT_WIDTH = 64.f;
+
+// Ground art repeats every GROUND_REPEAT_WIDTH world units across the ground
+// and stretches to its height. An atlas region can't wrap, so it's a quad per
+// repeat, only those overlapping clip.
+static void
+push_ground(Render_List *render, u8 layer, u16 depth, Rectangle bounds, Rectangle clip) {
+    f32 x0 = fmaxf(bounds.x, clip.x);
+    f32 x1 = fminf(bounds.x + bounds.width, clip.x + clip.width);
+    if(x0 >= x1) return;
+
+    s32 first = (s32)floorf((x0 - bounds.x) / GROUND_REPEAT_WIDTH);
+    s32 end = (s32)ceilf((x1 - bounds.x) / GROUND_REPEAT_WIDTH);
+    for(s32 i = first; i < end; i++) {
+        f32 x = bounds.x + i * GROUND_REPEAT_WIDTH;
+        f32 width = fminf(GROUND_REPEAT_WIDTH, bounds.x + bounds.width - x);
+        Rectangle src = get_region_rec(t_ground, {0, 0, t_ground.rec.width * width / GROUND_REPEAT_WIDTH, t_ground.rec.height});
+        push_texture(render, layer, depth, t_ground.texture, src, {x, bounds.y, width, bounds.height}, WHITE);
+    }
+}
 static Music m_music;
 
+// Sprites can hang off their collision bounds by up to the largest frame
+static constexpr f32 DRAW_CULL_MARGIN = 96.f;
+
+struct Draw_Stats {
+    u32 visited;
+    u32 drawn;
+    u32 culled;
+};
+static Draw_Stats g_draw_stats;
+
+inline static Rectangle
+get_draw_rec(Entity *entity) {
+    if(entity->flags & ENTITY_FLAG_GROUND) return get_bounds(entity);
+
+    Rectangle sprite_rec = get_anim_sprite_rec(entity->sprite);
+    return {entity->pos.x, entity->pos.y, sprite_rec.width, sprite_rec.height};
+}
+
+inline static u8
+get_render_layer(Entity *entity) {
+    if(entity->flags & ENTITY_FLAG_GROUND) return RENDER_LAYER_GROUND;
+    if(entity->flags & ENTITY_FLAG_PLAYER) return RENDER_LAYER_PLAYER;
+    if(entity->phys_state == PHYS_STATE_STATIONARY) return RENDER_LAYER_PROPS;
+    return RENDER_LAYER_ACTORS;
+}
+
+#include "static_layer.cpp"
+
+// Only entities in grid cells around the view are visited. Within a layer the
+// entity list index is the depth, the same order as drawing the whole list.
+// Entities in the static layer cache are skipped while it's enabled.
 static void
-draw_entities(Entity_List *entity_list) {
-    for(s32 entity_index = 0; entity_index < entity_list->entity_count; entity_index++) {
-        Entity *entity = &entity_list->entities[entity_index];
-        if(entity->flags & ENTITY_FLAG_GROUND) {
-            Rectangle bounds = get_bounds(entity);
-            //DrawRectangleRec(bounds, entity->color);
-            DrawTextureQuad(t_ground, {bounds.width / 64.f, 1}, {0,0}, bounds, WHITE);
-        } else {
-            Rectangle sprite_rec = get_anim_sprite_rec(entity->sprite);
-            DrawTextureRec(t_sprites, sprite_rec, entity->pos, WHITE);
+draw_entities(Render_List *render, Entity_List *entity_list, Spatial_Grid *grid, Static_Cache *cache, Rectangle view) {
+    u32 drawn = 0;
+    u32 visited = 0;
+
+    Rectangle query = expand_rec(view, DRAW_CULL_MARGIN);
+    s32 cx0 = get_grid_coord(query.x), cx1 = get_grid_coord(query.x + query.width);
+    s32 cy0 = get_grid_coord(query.y), cy1 = get_grid_coord(query.y + query.height);
+    u32 query_stamp = ++g_query_stamp;
+
+    for(s32 cy = cy0; cy <= cy1; cy++) {
+        for(s32 cx = cx0; cx <= cx1; cx++) {
+            u32 *entries;
+            u32 entry_count = get_grid_cell(grid, cx, cy, &entries);
+            for(u32 i = 0; i < entry_count; i++) {
+                Entity *entity = &entity_list->entities[entries[i]];
+                if(entity->query_stamp == query_stamp) continue;
+                entity->query_stamp = query_stamp;
+                visited += 1;
+
+                if(entity->static_cached && cache->enabled) continue;
+                if(!CheckCollisionRecs(get_draw_rec(entity), view)) continue;
+
+                u16 depth = (u16)entries[i];
+                if(entity->flags & ENTITY_FLAG_GROUND) {
+                    push_ground(render, RENDER_LAYER_GROUND, depth, get_bounds(entity), view);
+                } else {
+                    Rectangle sprite_rec = get_region_rec(t_sprites, get_anim_sprite_rec(entity->sprite));
+                    push_texture_rec(render, get_render_layer(entity), depth, t_sprites.texture, sprite_rec, entity->pos, WHITE);
+                }
+                drawn += 1;
+            }
         }
     }
+
+    g_draw_stats.visited = visited;
+    g_draw_stats.drawn = drawn;
+    g_draw_stats.culled = entity_list->entity_count - drawn;
 }
 
 static void
-draw_dialog(Entity *player_entity) {
+draw_dialog(Render_List *render, Entity *player_entity) {
     auto seq_def = d_sequences[player_entity->dialog.id];
-    DrawRectangleRec({0,0, SCREEN_WIDTH, SCREEN_HEIGHT/4.f}, {0,0,0,128});
-    DrawText(seq_def.lines[player_entity->dialog.line], 24, 64, 20, WHITE); 
+    push_rect(render, RENDER_LAYER_DIALOG, 0, {0,0, SCREEN_WIDTH, SCREEN_HEIGHT/4.f}, {0,0,0,128});
+    push_cached_text(render, &g_text_cache, RENDER_LAYER_DIALOG, 1, seq_def.lines[player_entity->dialog.line], 24, 64, 20, WHITE);
 }
 
+#include "particles.cpp"
+#include "damage.cpp"
+#include "projectiles.cpp"
+#include "ai.cpp"
+#include "debug.cpp"
+#include "render_stats.cpp"
+
 static Entity_ID 
 make_zone_1(void) {
     init_entity_list(g_entity_list);
@@ -608,7 +890,7 @@ make_zone_1(void) {
 
         entity = add_npc_entity(g_entity_list);
         entity->pos = {850, 259};
-        entity->sprite.sequence = GIRL_1;
+        play_anim(&entity->sprite, GIRL_1);
         entity->flags = ENTITY_FLAG_NO_COLLIDE | ENTITY_FLAG_INTERACTABLE;
         entity->phys_state = PHYS_STATE_STATIONARY;
         entity->dialog.id = DIALOG_SEQUENCE_2;
@@ -629,11 +911,7 @@ static Entity_ID
 make_zone_2(void) {
     init_entity_list(g_entity_list);
 
-    UnloadTexture(t_ground);
-    t_ground = LoadTexture("graphics/indoor_ground.png");
-
-    UnloadTexture(t_bg);
-    t_bg = LoadTexture("graphics/indoor_bg.png");
+    set_zone_art(ZONE_ART_INDOOR);
 
 
     // Ground0
@@ -657,7 +935,7 @@ make_zone_2(void) {
 
     entity = add_npc_entity(g_entity_list);
     entity->pos = {60, 268};
-    entity->sprite.sequence = DEKARD;
+    play_anim(&entity->sprite, DEKARD);
     entity->flags = ENTITY_FLAG_INTERACTABLE;
     entity->phys_state = PHYS_STATE_STATIONARY;
     entity->dialog.id = DIALOG_DEKARD;
@@ -678,11 +956,7 @@ make_dungeon(void) {
 
     u32 level = g_current_zone - 2;
 
-    UnloadTexture(t_ground);
-    t_ground = LoadTexture("graphics/cyberpink_ground.png");
-
-    UnloadTexture(t_bg);
-    t_bg = LoadTexture("graphics/cyberpink_bg.png");
+    set_zone_art(ZONE_ART_CYBERPINK);
 
     // Ground0
     Entity *entity = add_ground_entity(g_entity_list);
@@ -728,11 +1002,7 @@ static Entity_ID
 make_zone_end(void) {
     init_entity_list(g_entity_list);
 
-    UnloadTexture(t_ground);
-    t_ground = LoadTexture("graphics/indoor_ground.png");
-
-    UnloadTexture(t_bg);
-    t_bg = LoadTexture("graphics/indoor_bg.png");
+    set_zone_art(ZONE_ART_INDOOR);
 
     // Ground0
     Entity *entity = add_ground_entity(g_entity_list);
@@ -755,7 +1025,7 @@ make_zone_end(void) {
 
     entity = add_npc_entity(g_entity_list);
     entity->pos = {60, 268};
-    entity->sprite.sequence = DEKARD;
+    play_anim(&entity->sprite, DEKARD);
     entity->flags = ENTITY_FLAG_INTERACTABLE;
     entity->phys_state = PHYS_STATE_STATIONARY;
     entity->dialog.id = DIALOG_DEKARD_END;
@@ -770,223 +1040,699 @@ make_zone_end(void) {
     return player_entity_id;
 }
 
+// Stress scene for -bench_projectiles and -bench_particles: a wide empty floor
+// with invulnerable dummies. The projectile bench has emitters around the player
+// keeping PROJECTILE_BENCH_TARGET projectiles alive, the particle bench keeps
+// PARTICLE_BENCH_TARGET particles alive with bursts around the player.
+static constexpr u32 PROJECTILE_BENCH_TARGET = 100000;
+static constexpr u32 PROJECTILE_BENCH_SPAWN_PER_TICK = 2000;
+static constexpr u32 PROJECTILE_BENCH_EMITTER_COUNT = 16;
+static constexpr u32 PROJECTILE_BENCH_REPORT_TICKS = 600;
+static constexpr u32 PARTICLE_BENCH_TARGET = 200000;
+static constexpr u32 PARTICLE_BENCH_BURST = 500;
+static bool g_projectile_bench;
+static bool g_particle_bench;
+
+static Entity_ID
+make_zone_bench(void) {
+    init_entity_list(g_entity_list);
+    g_current_zone = 3;
 
+    set_zone_art(ZONE_ART_CYBERPINK);
 
-int main(int argc, char **argv) {
-    Allocator mem = make_allocator(MB(256));
-    InitWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "ld48");
-    HideCursor();
-    SetTargetFPS(60.f);
-    InitAudioDevice();
-    SetMasterVolume(0.5);
-
-    t_sprites = LoadTexture("graphics/sprites.png");
-    t_bg = LoadTexture("graphics/desert_bg.png");
-    t_ground = LoadTexture("graphics/desert_ground.png");
-    
-    g_sounds[SOUND_ROBOT] = LoadSound("sound/robot.wav");
-    g_sounds[SOUND_DUNGEON_DOOR] = LoadSound("sound/dungeon_door.wav");
-    g_sounds[SOUND_DOOR] = LoadSound("sound/door.wav");
-    g_sounds[SOUND_SHOOT] = LoadSound("sound/shoot.wav");
-    g_sounds[SOUND_EXPLOSION] = LoadSound("sound/explosion.wav");
-    g_sounds[SOUND_PICKUP] = LoadSound("sound/pickup.wav");
+    Entity *entity = add_ground_entity(g_entity_list);
+    entity->pos = {-4000, 300};
+    entity->collision_rec = {0, 0, 8000, 128};
 
-    m_music = LoadMusicStream("sound/music_desert.mp3");
-    SetMusicVolume(m_music, 0.5);
-    PlayMusicStream(m_music);
+    for(u32 e_idx = 0; e_idx < 256; e_idx++) {
+        entity = add_enemy_entity(g_entity_list, 1, e_idx % 2);
+        entity->flags |= ENTITY_FLAG_INVULNERABLE;
+        entity->pos = {static_cast<f32>(get_rand(&g_rand_state) % 8000) - 4000.f, 264};
+    }
 
-    init_rand(&g_rand_state);
+    Entity_ID player_entity_id = add_player_entity(g_entity_list);
+    Entity *player_entity = get_entity(g_entity_list, player_entity_id);
+    player_entity->pos = {0, 300-34};
+    player_entity->flags |= ENTITY_FLAG_INVULNERABLE;
 
-    Camera2D cam = {};
-    cam.target = {0, 0};
-    cam.rotation = 0.f;
-    cam.zoom = 4.f;
+    return player_entity_id;
+}
 
-    g_entity_list = alloc(&mem, Entity_List);
-   
-    Entity_ID player_entity_id = make_zone_1();
-    
-    const s32 max_projectile_count = 4;
-    Projectile *projectiles = alloc_array(&mem, Projectile, max_projectile_count);
-    s32 projectile_count = 0;
-    
-    Vector2 last_mouse_pos = {};
+static void
+tick_projectile_bench(Projectile_Pool *pool, Vector2 center) {
+    static f32 angle = 0.f;
+    static f64 tick_ms_total = 0.0;
+    static u32 report_ticks = 0;
+
+    u32 spawn_count = PROJECTILE_BENCH_TARGET - pool->count;
+    if(pool->count > PROJECTILE_BENCH_TARGET) spawn_count = 0;
+    if(spawn_count > PROJECTILE_BENCH_SPAWN_PER_TICK) spawn_count = PROJECTILE_BENCH_SPAWN_PER_TICK;
+
+    for(u32 idx = 0; idx < spawn_count; idx++) {
+        u32 emitter = idx % PROJECTILE_BENCH_EMITTER_COUNT;
+        f32 emitter_angle = emitter * (2.f * PI / PROJECTILE_BENCH_EMITTER_COUNT);
+        Vector2 origin = add_vec2(center, {cosf(emitter_angle) * 600.f, sinf(emitter_angle) * 150.f - 200.f});
+
+        angle += 0.61803f;
+        Vector2 velocity = {cosf(angle) * 3.f, sinf(angle) * 3.f};
+        spawn_projectile(pool, origin, velocity, 0, 0, 120 + (idx % 60));
+    }
 
-    f64 accumulator = 0.0;
-    while(!WindowShouldClose()) {
-        accumulator += GetFrameTime();
+    tick_ms_total += g_projectile_stats.tick_ms;
+    if(++report_ticks == PROJECTILE_BENCH_REPORT_TICKS) {
+        printf("projectile bench: %u live, %.3f ms avg tick, %u hits\n", pool->count,
+               tick_ms_total / report_ticks, g_projectile_stats.hits);
+        tick_ms_total = 0.0;
+        report_ticks = 0;
+        g_projectile_stats.hits = 0;
+    }
+}
 
-        UpdateMusicStream(m_music);
+static void
+tick_particle_bench(Particle_Pool *pool, Vector2 center) {
+    static f64 tick_ms_total = 0.0;
+    static u32 report_ticks = 0;
 
-        BeginDrawing();
-        ClearBackground(BLACK);
+    while(pool->count + PARTICLE_BENCH_BURST <= PARTICLE_BENCH_TARGET) {
+        Vector2 pos = add_vec2(center, {particle_rand(-200.f, 200.f), particle_rand(-120.f, 60.f)});
+        emit_particle_burst(pool, pos, PARTICLE_BENCH_BURST, 3.f, 60, ORANGE);
+    }
 
+    tick_ms_total += g_particle_stats.tick_ms;
+    if(++report_ticks == PROJECTILE_BENCH_REPORT_TICKS) {
+        printf("particle bench: %u live, %.3f ms avg tick, %.3f ms last draw\n", pool->count,
+               tick_ms_total / report_ticks, g_particle_stats.draw_ms);
+        tick_ms_total = 0.0;
+        report_ticks = 0;
+    }
+}
+
+// Horde scenario (-horde [count]): count corpos and a quarter as many pickups,
+// HORDE_SPACING units apart on average along a long run of platforms, with
+// stray corpo shots kept in flight across the whole area. This is the standard
+// scene for measuring how tick, draw and memory scale, it reports every
+// HORDE_REPORT_FRAMES frames.
+static constexpr u32 HORDE_DEFAULT_COUNT = 20000;
+static constexpr u32 HORDE_MAX_COUNT = 48000; // Corpos and pickups have to fit the entity list
+static constexpr f32 HORDE_SPACING = 4.f;
+static constexpr f32 HORDE_SEGMENT_WIDTH = 1024.f;
+static constexpr u32 HORDE_SHOTS_PER_TICK = 500;
+static constexpr u32 HORDE_REPORT_FRAMES = 600;
+static u32 g_horde_count;
+
+static Entity_ID
+make_zone_horde(u32 count) {
+    init_entity_list(g_entity_list);
+    g_current_zone = 3;
+
+    set_zone_art(ZONE_ART_CYBERPINK);
+
+    u32 width = (u32)(count * HORDE_SPACING);
+    f32 left = -(f32)width / 2.f;
+    for(f32 x = left; x < left + width; x += HORDE_SEGMENT_WIDTH) {
+        Entity *entity = add_ground_entity(g_entity_list);
+        entity->pos = {x, 300};
+        entity->collision_rec = {0, 0, HORDE_SEGMENT_WIDTH, 128};
+
+        entity = add_ground_entity(g_entity_list);
+        entity->pos = {x + 384, 240};
+        entity->collision_rec = {0, 0, 128, 16};
+    }
+
+    for(u32 e_idx = 0; e_idx < count; e_idx++) {
+        Entity *entity = add_enemy_entity(g_entity_list, 1, get_rand(&g_rand_state) % 2);
+        entity->pos = {left + get_rand(&g_rand_state) % width, 264};
+    }
+
+    for(u32 p_idx = 0; p_idx < count / 4; p_idx++) {
+        Entity *entity = add_item_drop_entity(g_entity_list, GUN);
+        entity->pos = {left + get_rand(&g_rand_state) % width, 280};
+        // Stay for the whole run so the entity count holds steady
+        cancel_timer(g_timers, entity->ttl_timer);
+        entity->ttl_timer = 0;
+    }
+
+    Entity_ID player_entity_id = add_player_entity(g_entity_list);
+    Entity *player_entity = get_entity(g_entity_list, player_entity_id);
+    player_entity->pos = {0, 300-34};
+    // Stray shots would keep restarting the scene
+    player_entity->flags |= ENTITY_FLAG_INVULNERABLE;
+
+    return player_entity_id;
+}
+
+// Keeps about half as many shots as corpos flying along the floor
+static void
+tick_horde(Projectile_Pool *pool) {
+    u32 target = g_horde_count / 2;
+    u32 spawn_count = (pool->count < target) ? target - pool->count : 0;
+    if(spawn_count > HORDE_SHOTS_PER_TICK) spawn_count = HORDE_SHOTS_PER_TICK;
+
+    u32 width = (u32)(g_horde_count * HORDE_SPACING);
+    for(u32 idx = 0; idx < spawn_count; idx++) {
+        u32 r = (u32)get_rand(&g_rand_state);
+        Vector2 origin = {-(f32)width / 2.f + r % width, 250.f + (r >> 24) % 40};
+        Vector2 velocity = {(r & 0x800000) ? AI_SHOT_SPEED : -AI_SHOT_SPEED, 0.f};
+        spawn_projectile(pool, origin, velocity, 0, ENTITY_FLAG_CORPO, 120 + (r >> 16) % 120);
+    }
+}
+
+static void
+report_horde_frame(Entity_List *entity_list, Allocator *mem) {
+    static f64 tick_ms_total = 0.0;
+    static f64 draw_ms_total = 0.0;
+    static u32 tick_count = 0;
+    static u32 frame_count = 0;
+
+    tick_ms_total += g_debug.tick_ms;
+    draw_ms_total += g_debug.draw_ms;
+    tick_count += g_debug.frame_tick_count;
+    if(++frame_count < HORDE_REPORT_FRAMES) return;
+
+    printf("horde: %u entities %u projectiles, %.3f ms/tick %.3f ms/draw, %.1f MB\n", entity_list->entity_count,
+           g_projectiles.count, tick_count ? tick_ms_total / tick_count : 0.0, draw_ms_total / frame_count,
+           mem->offset / (1024.0 * 1024.0));
+    tick_ms_total = 0.0;
+    draw_ms_total = 0.0;
+    tick_count = 0;
+    frame_count = 0;
+}
+
+// Runs before tick_entities so movement input takes effect on the same tick
+static void
+update_player_movement(Entity *player_entity, Input_Tick *input) {
+    if(in_dialog(player_entity)) return;
+
+    if(input->down & INPUT_RIGHT) {
+        if(player_entity->phys_state == PHYS_STATE_STANDING) {
+            player_entity->velocity.x = 1.f;
+        } else {
+            player_entity->velocity.x = 0.5f;
+        }
+        play_anim(&player_entity->sprite, PLAYER_RUN_RIGHT_FIST);
+    } else if(input->down & INPUT_LEFT) {
+        if(player_entity->phys_state == PHYS_STATE_STANDING) {
+            player_entity->velocity.x = -1.f;
+        } else {
+            player_entity->velocity.x = -0.5f;
+        }
+        play_anim(&player_entity->sprite, PLAYER_RUN_LEFT_FIST);
+    } else {
+        if(player_entity->sprite.sequence == PLAYER_RUN_RIGHT_FIST) {
+            play_anim(&player_entity->sprite, PLAYER_STAND_RIGHT);
+        } else if(player_entity->sprite.sequence == PLAYER_RUN_LEFT_FIST) {
+            play_anim(&player_entity->sprite, PLAYER_STAND_LEFT);
+        }
+        player_entity->velocity.x = 0.f;
+    }
+
+    if((input->pressed & INPUT_JUMP) && player_entity->phys_state != PHYS_STATE_FALLING) {
+        player_entity->velocity.y = -1.5f;
+        player_entity->ground = 0;
+        player_entity->phys_state = PHYS_STATE_JUMPING;
+    }
+}
+
+// Runs after tick_entities, an interact press that starts a dialog also skips its first line
+static void
+update_player_actions(Entity *player_entity, Input_Tick *input) {
+    if((input->pressed & INPUT_INTERACT) == 0 || fabsf(player_entity->velocity.x) != 0.f) return;
+
+    if(in_dialog(player_entity)) {
+        continue_dialog(player_entity);
+    } else if(player_entity->sprite.sequence == PLAYER_STAND_RIGHT ||
+       player_entity->sprite.sequence == PLAYER_RUN_RIGHT_FIST) {
+        play_anim(&player_entity->sprite, PLAYER_PUNCH_RIGHT);
+    } else if(player_entity->sprite.sequence == PLAYER_STAND_LEFT ||
+        player_entity->sprite.sequence == PLAYER_RUN_LEFT_FIST){
+        play_anim(&player_entity->sprite, PLAYER_PUNCH_LEFT);
+    }
+
+    if(g_current_zone > 2 && g_current_zone < 28) {
+        Vector2 aim = input->mouse;
+        Vector2 screen_center = {SCREEN_WIDTH / 2.f, SCREEN_HEIGHT / 2.f};
+        aim.x -= screen_center.x;
+        aim.y -= screen_center.y;
+
+        Vector2 muzzle = add_vec2(player_entity->pos, {16.f, 16.f});
+        if(spawn_projectile(&g_projectiles, muzzle, mul_vec2_f(normalize(aim), PROJECTILE_SPEED), player_entity->id, 0, ticks_from_seconds(0.15f))) {
+            play_sound(SOUND_SHOOT);
+        }
+    }
+}
+
+// What the simulation keeps from frame to frame. With the pipeline running
+// only the simulation thread touches it, except that the main thread polls
+// input into it and sets the frame timing while that thread is idle.
+struct Sim_State {
+    Camera2D cam;
+    Entity_ID player_entity_id;
+    f64 accumulator;
+    f32 frame_time;
+    Input_Queue input_queue;
+    Input_Recording recording;
+    Input_Recording replay; // Separate so -record and -replay can be combined
+    bool replaying;
+    const char *record_path;
+    Allocator *mem;
+};
+
+// Runs the frame's ticks and builds it into render
+static void
+simulate_frame(Sim_State *sim, Render_List *render) {
+    f64 frame_start = sys_get_time();
+    g_frame_render = render;
+    sim->accumulator += sim->frame_time;
+
+    g_debug.frame_tick_count = 0;
+    while(sim->accumulator > TIME_STEP) {
+        // Zones switch on a tick boundary so recorded input replays identically
         if(g_zone_load > 1) {
             printf("!!!!!!!!!!\n !!! ZONE LOAD %u\n!!!!!!!!!!!!!\n", g_zone_load);
             if(g_zone_load == 2) {
-                player_entity_id = make_zone_2();
+                sim->player_entity_id = make_zone_2();
                 g_current_zone = 2;
+            } else if(g_zone_load == g_current_zone) {
+                // Player died, restart the level
+                sim->player_entity_id = make_dungeon();
             } else if(g_current_zone >= 27) {
                 g_current_zone += 1;
-                player_entity_id = make_zone_end();
-                
+                sim->player_entity_id = make_zone_end();
+            
             } else {
                 g_current_zone += 1;
-                player_entity_id = make_dungeon();
+                sim->player_entity_id = make_dungeon();
             }
 
+            // These pools live outside the entity list and still hold the old zone's
+            // shots, sparks and pending despawns, none of which belong in the new one
+            g_despawns.count = 0;
+            g_projectiles.count = 0;
+            g_particles.count = 0;
             g_zone_load = -1;
-        }
 
-        DrawTextureEx(t_bg, {0,0}, 0, 2.f, WHITE);
-        
-                    
-        while(accumulator > TIME_STEP) {
-
-            tick_entities(g_entity_list);
-
-            for(u32 idx = 0; idx < projectile_count;) {
-                Projectile *projectile = &projectiles[idx]; 
-
-                projectile->lifetime += TIME_STEP;
-                projectile->pos = add_vec2(projectile->pos, mul_vec2_f(projectile->dir, 20.f));
-
-                bool collided = false;
-                for(s32 entity_idx = 0; entity_idx < g_entity_list->entity_count; entity_idx++) {
-                    Entity *entity = &g_entity_list->entities[entity_idx];
-
-                    if(projectile->shooter == entity->id) continue;
-                                        
-                    Rectangle entity_rect = get_bounds(entity);
-                    collided = CheckCollisionCircleRec(projectile->pos, 8.f, entity_rect);
-                    
-                    if(collided && (entity->flags & ENTITY_FLAG_NO_COLLIDE) == 0) {
-                        if((entity->flags & ENTITY_FLAG_INVULNERABLE) == 0) {
-                            entity->hp -= 25.f;
-                            if(entity->hp <= 0.f) {
-                                //remove_entity(g_entity_list, entity->id); // temp
-                                entity->flags = entity->flags | (ENTITY_FLAG_INVULNERABLE | ENTITY_FLAG_NO_COLLIDE);
-                                entity->phys_state = PHYS_STATE_STATIONARY;
-                                entity->collision_rec = {0,0,0,0};
-                                if(entity->sprite.sequence == ROBOT_STAND) {
-                                    play_anim(&entity->sprite, ROBOT_BLOWUP);
-                                } else if(entity->sprite.sequence == FLOAT_BOT_STAND) {
-                                    play_anim(&entity->sprite, FLOAT_BOT_BLOWUP);
-                                }
-                                PlaySound(g_sounds[SOUND_EXPLOSION]);
+            update_camera(&sim->cam, get_entity(g_entity_list, sim->player_entity_id)->pos);
+        }
 
-                            }
-                        }
-                        break;
-                    } else { collided = false; }
-                }
+        Input_Tick input = next_input_tick(&sim->input_queue);
+        if(sim->replaying && !replay_input_tick(&sim->replay, &input)) {
+            sim->replaying = false;
+        }
+        if(sim->record_path) {
+            record_input_tick(&sim->recording, input);
+        }
 
-                if(projectile->lifetime > 0.15f || collided) { 
-                    if(idx != projectile_count - 1) {
-                        projectiles[idx] = projectiles[projectile_count - 1];
-                        projectile_count--;
-                        continue;
-                    } else {
-                        projectile_count--;
-                    }
-                }
-                idx += 1;
-            } // for each projectile
- 
+        Entity *player_entity = get_entity(g_entity_list, sim->player_entity_id);
+        update_player_movement(player_entity, &input);
+        update_nav_goal(g_nav, g_entity_list, player_entity->ground);
+        tick_ai(g_entity_list, g_grid, player_entity);
 
-            accumulator -= TIME_STEP;
-        } // while accumulator
+        tick_entities(g_entity_list, g_grid, get_camera_view(&sim->cam), &input);
+        advance_timers(g_timers);
+        flush_despawns(&g_despawns, g_entity_list);
 
-        Entity *player_entity = get_entity(g_entity_list, player_entity_id);
-        update_camera(&cam, player_entity->pos);
-        
-        if(is_interact_key() && fabsf(player_entity->velocity.x) == 0.f) {
-            if(in_dialog(player_entity)) {
-                continue_dialog(player_entity);
-            } else if(player_entity->sprite.sequence == PLAYER_STAND_RIGHT ||
-               player_entity->sprite.sequence == PLAYER_RUN_RIGHT_FIST) {
-                play_anim(&player_entity->sprite, PLAYER_PUNCH_RIGHT);
-            } else if(player_entity->sprite.sequence == PLAYER_STAND_LEFT ||
-                player_entity->sprite.sequence == PLAYER_RUN_LEFT_FIST){
-                play_anim(&player_entity->sprite, PLAYER_PUNCH_LEFT);
-            }
+        // The entity list may have been swapped around by the tick
+        update_player_actions(get_entity(g_entity_list, sim->player_entity_id), &input);
+        update_camera(&sim->cam, get_entity(g_entity_list, sim->player_entity_id)->pos);
 
-            if(g_current_zone > 2 && g_current_zone < 28) {
-                last_mouse_pos = GetMousePosition();
-                Vector2 screen_center = {SCREEN_WIDTH / 2.f, SCREEN_HEIGHT / 2.f};
-                last_mouse_pos.x -= screen_center.x;
-                last_mouse_pos.y -= screen_center.y;
-
-                if(projectile_count < max_projectile_count) {
-                    Projectile *bullet = projectiles + projectile_count;
-                    bullet->pos = add_vec2(player_entity->pos, {16.f, 16.f});
-                    bullet->dir = normalize(last_mouse_pos); 
-                    bullet->lifetime = 0.f;
-                    bullet->shooter = player_entity_id;
-                    projectile_count += 1;
-                    PlaySound(g_sounds[SOUND_SHOOT]);
-                }
-            }
+        build_spatial_grid(g_grid, g_entity_list);
+        tick_projectiles(&g_projectiles, g_grid, g_entity_list, g_damage);
+        resolve_damage(g_damage, g_entity_list);
+        if(g_particle_bench) {
+            tick_particle_bench(&g_particles, get_entity(g_entity_list, sim->player_entity_id)->pos);
+        }
+        tick_particles(&g_particles);
+        if(g_horde_count) {
+            tick_horde(&g_projectiles);
+        }
+        if(g_projectile_bench) {
+            tick_projectile_bench(&g_projectiles, get_entity(g_entity_list, sim->player_entity_id)->pos);
         }
 
-        if(!in_dialog(player_entity)) {
-            if(IsKeyDown(KEY_D)) {
-                if(player_entity->phys_state == PHYS_STATE_STANDING) {
-                    player_entity->velocity.x = 1.f;
-                } else {
-                    player_entity->velocity.x = 0.5f;
-                }
-                play_anim(&player_entity->sprite, PLAYER_RUN_RIGHT_FIST);
-            } else if(IsKeyDown(KEY_A)) {
-                if(player_entity->phys_state == PHYS_STATE_STANDING) {
-                    player_entity->velocity.x = -1.f;
-                } else {
-                    player_entity->velocity.x = -0.5f;
-                }
-                play_anim(&player_entity->sprite, PLAYER_RUN_LEFT_FIST);
+        sim->accumulator -= TIME_STEP;
+        g_debug.frame_tick_count += 1;
+    } // while accumulator
+
+    Entity *player_entity = get_entity(g_entity_list, sim->player_entity_id);
+    update_camera(&sim->cam, player_entity->pos);
+
+    // Extrapolate the frame's camera to the time it's presented, the simulation
+    // runs behind real time by whatever is left in the accumulator. The
+    // simulation's camera stays where the last tick left it, so LOD tiers and
+    // replays don't depend on the wall clock.
+    Camera2D camera = sim->cam;
+    if(g_debug.late_latch) {
+        f32 alpha = (f32)(sim->accumulator / TIME_STEP);
+        update_camera(&camera, add_vec2(player_entity->pos, mul_vec2_f(player_entity->velocity, 2.f * alpha)));
+    }
+
+    f64 draw_start = sys_get_time();
+    Rectangle view = get_camera_view(&camera);
+    render->camera = camera;
+    render->input_time = sim->input_queue.unreported_time;
+    sim->input_queue.unreported_time = 0.0;
+    next_text_cache_frame(&g_text_cache);
+
+    push_texture(render, RENDER_LAYER_BACKGROUND, 0, t_bg.texture, t_bg.rec, {0, 0, t_bg.rec.width * 2.f, t_bg.rec.height * 2.f}, WHITE);
+    draw_static_cache(render, &g_static_cache, g_entity_list, g_grid, view);
+    draw_entities(render, g_entity_list, g_grid, &g_static_cache, view);
+    draw_projectiles(render, &g_projectiles, view);
+    draw_particles(render, &g_particles, &g_particle_layer, view);
+
+    if(in_dialog(player_entity)) {
+        draw_dialog(render, player_entity);
+    }
+  
+    if(g_current_zone > 2 && g_current_zone < 28) {
+        char buf[32];
+        snprintf(buf, 32, "LeveL: %u", g_current_zone - 2);
+        push_cached_text(render, &g_text_cache, RENDER_LAYER_HUD, 0, buf, 10, 10, 20, WHITE);
+        snprintf(buf, 32, "HP: %.0f", player_entity->hp);
+        push_cached_text(render, &g_text_cache, RENDER_LAYER_HUD, 0, buf, 10, 34, 20, WHITE);
+    }
+
+    draw_debug_overlay(render);
+    draw_render_stats_overlay(render);
+
+    f64 draw_end = sys_get_time();
+    g_debug.tick_ms = (f32)((draw_start - frame_start) * 1000.0);
+    g_debug.draw_ms = (f32)((draw_end - draw_start) * 1000.0);
+    g_debug.entity_count = g_entity_list->entity_count;
+    g_debug.mem_used = sim->mem->offset;
+    g_debug.mem_size = sim->mem->size;
+    if(g_horde_count) {
+        report_horde_frame(g_entity_list, sim->mem);
+    }
+}
+
+// Frame N+1 is simulated and built on its own thread while the main thread
+// submits frame N. Everything the two share is handed over with the
+// semaphores: the main thread only touches Sim_State and the list being built
+// between done and the next start.
+struct Frame_Pipeline {
+    Sys_Thread thread;
+    Sys_Semaphore start;
+    Sys_Semaphore done;
+    Sim_State *sim;
+    Render_List *render; // Being built
+    bool quit;
+};
+
+static void
+sim_thread_proc(void *data) {
+    Frame_Pipeline *pipeline = (Frame_Pipeline*)data;
+    for(;;) {
+        sys_wait_semaphore(&pipeline->start);
+        if(pipeline->quit) break;
+        simulate_frame(pipeline->sim, pipeline->render);
+        sys_signal_semaphore(&pipeline->done);
+    }
+}
+
+static constexpr u32 HEADLESS_DEFAULT_FRAMES = 600;
+
+int main(int argc, char **argv) {
+    const char *record_path = nullptr;
+    const char *replay_path = nullptr;
+    u32 max_frames = 0; // Run until the window closes
+    bool low_res = false;
+    bool dynamic_resolution = false;
+    bool single_thread = false;
+    u64 seed = 0; // From the clock
+    const char *render_stats_path = nullptr;
+    const char *capture_path = nullptr;
+    for(s32 arg = 1; arg < argc; arg++) {
+        if(strcmp(argv[arg], "-record") == 0 && arg + 1 < argc) {
+            record_path = argv[++arg];
+        } else if(strcmp(argv[arg], "-replay") == 0 && arg + 1 < argc) {
+            replay_path = argv[++arg];
+        } else if(strcmp(argv[arg], "-bench_projectiles") == 0) {
+            g_projectile_bench = true;
+        } else if(strcmp(argv[arg], "-bench_particles") == 0) {
+            g_particle_bench = true;
+        } else if(strcmp(argv[arg], "-horde") == 0) {
+            g_horde_count = HORDE_DEFAULT_COUNT;
+            if(arg + 1 < argc && argv[arg + 1][0] != '-') {
+                g_horde_count = (u32)strtoul(argv[++arg], nullptr, 10);
+            }
+            if(g_horde_count < 1) g_horde_count = 1;
+            if(g_horde_count > HORDE_MAX_COUNT) g_horde_count = HORDE_MAX_COUNT;
+        } else if(strcmp(argv[arg], "-lowres") == 0) {
+            low_res = true;
+        } else if(strcmp(argv[arg], "-dynres") == 0) {
+            dynamic_resolution = true;
+        } else if(strcmp(argv[arg], "-single_thread") == 0) {
+            single_thread = true;
+        } else if(strcmp(argv[arg], "-frames") == 0 && arg + 1 < argc) {
+            max_frames = (u32)strtoul(argv[++arg], nullptr, 10);
+        } else if(strcmp(argv[arg], "-renderer") == 0 && arg + 1 < argc) {
+            const char *name = argv[++arg];
+            if(strcmp(name, "raylib") == 0) {
+                g_backend = &g_raylib_backend;
+            } else if(strcmp(name, "null") == 0) {
+                g_backend = &g_null_backend;
+            } else if(strcmp(name, "record") == 0) {
+                g_backend = &g_record_backend;
+            } else if(strcmp(name, "soft") == 0) {
+                g_backend = &g_soft_backend;
             } else {
-                if(player_entity->sprite.sequence == PLAYER_RUN_RIGHT_FIST) {
-                    play_anim(&player_entity->sprite, PLAYER_STAND_RIGHT);
-                } else if(player_entity->sprite.sequence == PLAYER_RUN_LEFT_FIST) {
-                    play_anim(&player_entity->sprite, PLAYER_STAND_LEFT);
-                }
-                player_entity->velocity.x = 0.f;
+                printf("Unknown renderer %s\n", name);
             }
+        } else if(strcmp(argv[arg], "-capture") == 0 && arg + 1 < argc) {
+            capture_path = argv[++arg];
+        } else if(strcmp(argv[arg], "-render_stats") == 0 && arg + 1 < argc) {
+            render_stats_path = argv[++arg];
+        } else if(strcmp(argv[arg], "-dump_frames") == 0 && arg + 1 < argc) {
+            g_soft.dump_dir = argv[++arg];
+        } else if(strcmp(argv[arg], "-seed") == 0 && arg + 1 < argc) {
+            seed = strtoull(argv[++arg], nullptr, 10);
+        } else {
+            printf("Unknown argument %s\n", argv[arg]);
+        }
+    }
 
-            if(IsKeyPressed(KEY_SPACE) && player_entity->phys_state != PHYS_STATE_FALLING) {
-                player_entity->velocity.y = -1.5f;
-                player_entity->last_ground = nullptr;
-                player_entity->phys_state = PHYS_STATE_JUMPING;
-            }
+    // Headless runs have no window to close, they stop after a fixed number of
+    // frames and step the simulation one tick per frame
+    bool headless = g_backend->headless;
+    if(headless && max_frames == 0) {
+        max_frames = HEADLESS_DEFAULT_FRAMES;
+    }
+
+    Allocator mem = make_allocator(MB(256));
+    if(!headless) {
+        InitWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "ld48");
+        HideCursor();
+        SetTargetFPS(60.f);
+        InitAudioDevice();
+        SetMasterVolume(0.5);
+    }
+    if(g_backend == &g_soft_backend) {
+        init_soft_renderer(&g_soft, &mem, SCREEN_WIDTH, SCREEN_HEIGHT);
+    }
+
+    load_atlas(&g_atlas, "graphics");
+    t_sprites = load_texture_region(&g_atlas, "graphics/sprites.png");
+    t_zone_bgs[ZONE_ART_DESERT] = load_texture_region(&g_atlas, "graphics/desert_bg.png");
+    t_zone_grounds[ZONE_ART_DESERT] = load_texture_region(&g_atlas, "graphics/desert_ground.png");
+    t_zone_bgs[ZONE_ART_INDOOR] = load_texture_region(&g_atlas, "graphics/indoor_bg.png");
+    t_zone_grounds[ZONE_ART_INDOOR] = load_texture_region(&g_atlas, "graphics/indoor_ground.png");
+    t_zone_bgs[ZONE_ART_CYBERPINK] = load_texture_region(&g_atlas, "graphics/cyberpink_bg.png");
+    t_zone_grounds[ZONE_ART_CYBERPINK] = load_texture_region(&g_atlas, "graphics/cyberpink_ground.png");
+    set_zone_art(ZONE_ART_DESERT);
+    
+    if(!headless) {
+        g_sounds[SOUND_ROBOT] = LoadSound("sound/robot.wav");
+        g_sounds[SOUND_DUNGEON_DOOR] = LoadSound("sound/dungeon_door.wav");
+        g_sounds[SOUND_DOOR] = LoadSound("sound/door.wav");
+        g_sounds[SOUND_SHOOT] = LoadSound("sound/shoot.wav");
+        g_sounds[SOUND_EXPLOSION] = LoadSound("sound/explosion.wav");
+        g_sounds[SOUND_PICKUP] = LoadSound("sound/pickup.wav");
+
+        m_music = LoadMusicStream("sound/music_desert.mp3");
+        SetMusicVolume(m_music, 0.5);
+        PlayMusicStream(m_music);
+    }
+
+    init_rand(&g_rand_state);
+    if(seed) g_rand_state.seed = seed;
+
+    Sim_State sim = {};
+    sim.mem = &mem;
+    sim.record_path = record_path;
+    if(replay_path) {
+        Input_Recording *replay = &sim.replay;
+        replay->max_tick_count = 60*60*60; // An hour of ticks
+        replay->ticks = alloc_array(&mem, Input_Tick, replay->max_tick_count);
+        sim.replaying = load_input_recording(replay, replay_path);
+        if(sim.replaying) {
+            g_rand_state.seed = replay->seed;
+        } else {
+            printf("Failed to load input recording %s\n", replay_path);
         }
-        
-        BeginMode2D(cam);
+    }
+
+    // Recording a replay saves what was replayed, and anything after it
+    Input_Recording *recording = &sim.recording;
+    if(record_path) {
+        recording->max_tick_count = 60*60*60;
+        recording->ticks = alloc_array(&mem, Input_Tick, recording->max_tick_count);
+        recording->seed = g_rand_state.seed;
+    }
+
+    Camera2D *cam = &sim.cam;
+    cam->target = {0, 0};
+    cam->rotation = 0.f;
+    cam->zoom = 4.f;
 
-        draw_entities(g_entity_list);
+    g_timers = alloc(&mem, Timer_Wheel);
+    init_timer_wheel(g_timers);
+    g_grid = alloc(&mem, Spatial_Grid);
+    g_damage = alloc(&mem, Damage_Buffer);
 
-        for(u32 idx = 0; idx < projectile_count; idx++) {
-            Projectile projectile = projectiles[idx]; 
-            DrawLineEx(projectile.pos, add_vec2(projectile.pos, mul_vec2_f(projectile.dir, 50)), 0.5f, YELLOW);
+    g_terrain = alloc(&mem, Terrain);
+    g_nav = alloc(&mem, Nav_Graph);
+    g_entity_list = alloc(&mem, Entity_List);
+   
+    init_render_list(&g_render_lists[0], &mem);
+    init_render_list(&g_render_lists[1], &mem);
+    g_frame_render = &g_render_lists[0];
+
+    if(g_horde_count) {
+        sim.player_entity_id = make_zone_horde(g_horde_count);
+    } else if(g_projectile_bench || g_particle_bench) {
+        sim.player_entity_id = make_zone_bench();
+    } else {
+        sim.player_entity_id = make_zone_1();
+    }
+    update_camera(cam, get_entity(g_entity_list, sim.player_entity_id)->pos);
+    // Normally rebuilt every tick, drawing needs it before the first one
+    build_spatial_grid(g_grid, g_entity_list);
+    
+    init_projectile_pool(&g_projectiles, &mem);
+    init_particle_pool(&g_particles, &mem);
+    init_static_cache(&g_static_cache);
+    init_text_cache(&g_text_cache);
+    if(low_res) {
+        // The world at one texel per unit, the HUD at full resolution
+        init_world_target(&g_world_target, (s32)cam->zoom);
+    } else if(dynamic_resolution) {
+        init_world_target(&g_world_target, 1);
+    }
+    if(dynamic_resolution) {
+        init_resolution_governor(&g_resolution_governor);
+    }
+    init_particle_layer(&g_particle_layer, &mem, (s32)(SCREEN_WIDTH / cam->zoom) + 1, (s32)(SCREEN_HEIGHT / cam->zoom) + 1);
+
+    Frame_Pipeline pipeline = {};
+    pipeline.sim = &sim;
+    bool threaded = !single_thread;
+    if(threaded) {
+        sys_init_semaphore(&pipeline.start, 0);
+        sys_init_semaphore(&pipeline.done, 0);
+        if(!sys_create_thread(&pipeline.thread, sim_thread_proc, &pipeline)) {
+            printf("Failed to start the simulation thread, running single threaded\n");
+            threaded = false;
         }
+    }
+    g_debug.threaded = threaded;
 
-        EndMode2D();
+    if(capture_path && !start_frame_capture(&g_capture, &mem, capture_path, SCREEN_WIDTH, SCREEN_HEIGHT)) {
+        printf("Failed to start capturing to %s\n", capture_path);
+    }
+    if(render_stats_path && !open_render_stats_export(&g_render_stats_export, render_stats_path)) {
+        printf("Failed to open %s\n", render_stats_path);
+    }
 
-        if(in_dialog(player_entity)) {
-            draw_dialog(player_entity);
+    // Each frame polls input, then simulates and builds one render list while
+    // submitting the other, the one built last frame. Single threaded the
+    // frame is built and submitted in the same iteration, so input sampled
+    // this frame is on screen at the end of it; threaded it's one frame later.
+    u32 frame_count = 0;
+    while((headless || !WindowShouldClose()) && (max_frames == 0 || frame_count < max_frames)) {
+        f64 frame_start = sys_get_time();
+        Render_List *building = &g_render_lists[frame_count & 1];
+        Render_List *submitting = threaded ? &g_render_lists[(frame_count + 1) & 1] : building;
+        frame_count += 1;
+
+        // The simulation thread is waiting for the start here
+        if(headless) {
+            sim.frame_time = TIME_STEP;
+        } else {
+            sim.frame_time = GetFrameTime();
+            poll_input(&sim.input_queue, frame_start);
+            poll_debug_keys();
         }
-      
-        if(g_current_zone > 2 && g_current_zone < 28) {
-            char buf[32];
-            snprintf(buf, 32, "LeveL: %u", g_current_zone - 2);
-            DrawText(buf, 10, 10, 20, WHITE); 
+
+        if(threaded) {
+            pipeline.render = building;
+            sys_signal_semaphore(&pipeline.start);
+        } else {
+            simulate_frame(&sim, building);
         }
 
-        DrawTextureRec(t_sprites, {448, 0, 32, 32}, add_vec2(GetMousePosition(), {-16,-16}), WHITE);
+        if(!headless) {
+            UpdateMusicStream(m_music);
+            for(u32 i = 0; i < submitting->sound_count; i++) {
+                PlaySound(g_sounds[submitting->sounds[i]]);
+            }
+        }
+
+        // Pushed at submit rather than by the simulation so it's as fresh as can be
+        push_texture_rec(submitting, RENDER_LAYER_CURSOR, 0, t_sprites.texture, get_region_rec(t_sprites, SPRITE_CURSOR_REC), add_vec2(GetMousePosition(), {-16,-16}), WHITE);
+
+        f64 input_time = submitting->input_time;
+        f64 submit_start = sys_get_time();
+        g_backend->begin_frame(BLACK);
+        execute_render_list(submitting, &g_world_target);
+        capture_frame(&g_capture);
+
+        f64 submit_time = sys_get_time();
+        g_backend->end_frame();
+        f64 present_time = sys_get_time();
+
+        if(threaded) {
+            sys_wait_semaphore(&pipeline.done);
+        }
+
+        // Published with the simulation thread idle, its debug overlay reads them
+        g_render_stats = submitting->stats;
+        g_render_stats.present_ms = (f32)((present_time - submit_time) * 1000.0);
+        g_capture_stats = g_capture.stats;
+        if(input_time != 0.0) {
+            add_latency_sample(input_time, submit_time, present_time);
+        }
+        g_debug.frame_ms = (f32)((submit_time - frame_start) * 1000.0);
+        g_debug.submit_ms = (f32)((submit_time - submit_start) * 1000.0);
+        write_render_stats(&g_render_stats_export, &g_render_stats, g_debug.frame_ms);
 
-        EndDrawing();
+        f32 whole_frame_ms = (f32)((sys_get_time() - frame_start) * 1000.0);
+        update_resolution_governor(&g_resolution_governor, &g_world_target, whole_frame_ms, g_render_stats.present_ms);
     }
 
-    CloseWindow();
+    if(threaded) {
+        pipeline.quit = true;
+        sys_signal_semaphore(&pipeline.start);
+        sys_join_thread(&pipeline.thread);
+        sys_destroy_semaphore(&pipeline.start);
+        sys_destroy_semaphore(&pipeline.done);
+    }
+
+    close_render_stats_export(&g_render_stats_export);
+    stop_frame_capture(&g_capture);
+    if(record_path && !save_input_recording(recording, record_path)) {
+        printf("Failed to save input recording %s\n", record_path);
+    }
+
+    if(g_backend == &g_record_backend) {
+        print_backend_recording();
+    }
+    if(g_backend == &g_soft_backend) {
+        shutdown_soft_renderer(&g_soft);
+    }
+
+    if(!headless) {
+        CloseWindow();
+    }
     destroy_allocator(&mem);
     return 0;
 }
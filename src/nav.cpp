@@ -0,0 +1,274 @@
+
+// Navigation over platforms. The top of every ground rect is a node, linked to
+// the nodes a mover can reach from it by walking over a seam or step, dropping
+// off an edge, or jumping up a short ledge. Enemies share one flow field
+// toward the player's platform: each node stores the link to take next. The
+// field is only recomputed when the player lands on a different platform, and
+// then it's one Dijkstra pass backwards from that platform over the graph.
+//
+// The graph is built the first time it's needed after init_entity_list, which
+// is the first tick of a zone. Doors and other stationary solids aren't part
+// of it, movers just get stopped by them.
+
+static constexpr u32 MAX_NAV_NODES = 4096;
+static constexpr u32 MAX_NAV_LINKS = 16*1024;
+static constexpr u32 NAV_HASH_SIZE = 2*MAX_NAV_NODES;
+static constexpr u16 NAV_NONE = UINT16_MAX;
+static constexpr f32 NAV_JUMP_HEIGHT = 16.f; // A standing jump clears about 16 units
+static constexpr f32 NAV_JUMP_GAP = 24.f;
+static constexpr f32 NAV_JUMP_COST = 64.f;
+static constexpr f32 NAV_EDGE_MARGIN = 16.f; // How far past an edge walkers aim
+
+enum {
+    NAV_LINK_WALK,
+    NAV_LINK_DROP,
+    NAV_LINK_JUMP,
+};
+
+struct Nav_Node {
+    f32 x0, x1;
+    f32 y;
+    Entity_ID ground;
+};
+
+struct Nav_Link {
+    u16 from;
+    u16 to;
+    u8 type;
+    f32 x; // Where the mover's center heads to take the link
+    f32 cost;
+};
+
+struct Nav_Heap_Entry {
+    f32 cost;
+    u16 node;
+};
+
+struct Nav_Graph {
+    bool dirty;
+    u32 node_count;
+    u32 link_count;
+    Nav_Node nodes[MAX_NAV_NODES];
+    Nav_Link links[MAX_NAV_LINKS];
+
+    // Links sorted by the node they lead to, for searching backwards
+    u32 in_start[MAX_NAV_NODES + 1];
+    u32 in_links[MAX_NAV_LINKS];
+
+    // Ground entity id -> node, open addressing
+    Entity_ID hash_ids[NAV_HASH_SIZE];
+    u16 hash_nodes[NAV_HASH_SIZE];
+
+    // Flow field toward goal
+    u16 goal;
+    u32 flow_link[MAX_NAV_NODES]; // Link to take from each node, UINT32_MAX when none
+    f32 flow_cost[MAX_NAV_NODES];
+    Nav_Heap_Entry heap[MAX_NAV_LINKS + 1];
+};
+static Nav_Graph *g_nav;
+
+struct Nav_Stats {
+    u32 flow_updates;
+    f32 flow_ms;
+};
+static Nav_Stats g_nav_stats;
+
+// Needs to be called whenever ground is added or removed
+static void
+mark_nav_dirty() {
+    g_nav->dirty = true;
+}
+
+inline static u32
+get_nav_hash(Entity_ID id) {
+    return (id * 2654435761u) & (NAV_HASH_SIZE - 1);
+}
+
+static u16
+get_nav_node(Nav_Graph *nav, Entity_ID ground) {
+    if(ground == 0) return NAV_NONE;
+
+    for(u32 slot = get_nav_hash(ground);; slot = (slot + 1) & (NAV_HASH_SIZE - 1)) {
+        if(nav->hash_ids[slot] == ground) return nav->hash_nodes[slot];
+        if(nav->hash_ids[slot] == 0) return NAV_NONE;
+    }
+}
+
+static void
+add_nav_link(Nav_Graph *nav, u16 from, u16 to, u8 type, f32 x) {
+    if(nav->link_count >= MAX_NAV_LINKS) return;
+
+    Nav_Node *a = &nav->nodes[from];
+    Nav_Node *b = &nav->nodes[to];
+    Nav_Link *link = &nav->links[nav->link_count++];
+    link->from = from;
+    link->to = to;
+    link->type = type;
+    link->x = x;
+    link->cost = fabsf((b->x0 + b->x1) - (a->x0 + a->x1)) * 0.5f + ((type == NAV_LINK_JUMP) ? NAV_JUMP_COST : 0.f);
+}
+
+// Links leaving a over its right edge (dir 1) or left edge (dir -1) to b
+static void
+link_nav_edge(Nav_Graph *nav, u16 from, u16 to, f32 dir) {
+    Nav_Node *a = &nav->nodes[from];
+    Nav_Node *b = &nav->nodes[to];
+    f32 edge = (dir > 0.f) ? a->x1 : a->x0;
+    f32 rise = a->y - b->y;
+
+    // Distance from the edge to b's near side, negative if b reaches back over a
+    f32 gap = (dir > 0.f) ? b->x0 - edge : edge - b->x1;
+    bool beyond = (dir > 0.f) ? (b->x1 > edge) : (b->x0 < edge);
+    if(!beyond) return;
+
+    if(fabsf(rise) <= STEP_HEIGHT && fabsf(gap) <= 1.f) {
+        add_nav_link(nav, from, to, NAV_LINK_WALK, edge + dir * NAV_EDGE_MARGIN);
+    } else if(rise < -STEP_HEIGHT && gap <= NAV_EDGE_MARGIN) {
+        f32 landing = edge + dir * NAV_EDGE_MARGIN;
+        if(landing >= b->x0 && landing <= b->x1) {
+            add_nav_link(nav, from, to, NAV_LINK_DROP, landing);
+        }
+    } else if(rise > STEP_HEIGHT && rise <= NAV_JUMP_HEIGHT && gap >= 0.f && gap <= NAV_JUMP_GAP) {
+        add_nav_link(nav, from, to, NAV_LINK_JUMP, edge - dir * NAV_EDGE_MARGIN * 0.5f);
+    }
+}
+
+static void
+build_nav_graph(Nav_Graph *nav, Entity_List *entity_list) {
+    nav->node_count = 0;
+    nav->link_count = 0;
+    memset(nav->hash_ids, 0, sizeof(nav->hash_ids));
+
+    for(s32 entity_index = 0; entity_index < entity_list->entity_count; entity_index++) {
+        Entity *entity = &entity_list->entities[entity_index];
+        if((entity->flags & ENTITY_FLAG_GROUND) == 0 || !is_terrain(entity)) continue;
+        if(nav->node_count >= MAX_NAV_NODES) break;
+
+        u16 node_index = (u16)nav->node_count++;
+        Rectangle bounds = get_bounds(entity);
+        nav->nodes[node_index] = {bounds.x, bounds.x + bounds.width, bounds.y, entity->id};
+
+        u32 slot = get_nav_hash(entity->id);
+        while(nav->hash_ids[slot] != 0) slot = (slot + 1) & (NAV_HASH_SIZE - 1);
+        nav->hash_ids[slot] = entity->id;
+        nav->hash_nodes[slot] = node_index;
+    }
+
+    // Levels have at most a few hundred platforms, built once per zone
+    for(u16 from = 0; from < nav->node_count; from++) {
+        for(u16 to = 0; to < nav->node_count; to++) {
+            if(from == to) continue;
+            link_nav_edge(nav, from, to, 1.f);
+            link_nav_edge(nav, from, to, -1.f);
+        }
+    }
+
+    // Counting sort of links by destination
+    memset(nav->in_start, 0, sizeof(u32)*(nav->node_count + 1));
+    for(u32 idx = 0; idx < nav->link_count; idx++) {
+        nav->in_start[nav->links[idx].to + 1] += 1;
+    }
+    for(u32 node = 0; node < nav->node_count; node++) {
+        nav->in_start[node + 1] += nav->in_start[node];
+    }
+    for(u32 idx = 0; idx < nav->link_count; idx++) {
+        nav->in_links[nav->in_start[nav->links[idx].to]++] = idx;
+    }
+    for(u32 node = nav->node_count; node > 0; node--) {
+        nav->in_start[node] = nav->in_start[node - 1];
+    }
+    nav->in_start[0] = 0;
+
+    nav->goal = NAV_NONE;
+    nav->dirty = false;
+}
+
+static void
+push_nav_heap(Nav_Heap_Entry *heap, u32 *count, Nav_Heap_Entry entry) {
+    u32 idx = (*count)++;
+    while(idx > 0) {
+        u32 parent = (idx - 1) / 2;
+        if(heap[parent].cost <= entry.cost) break;
+        heap[idx] = heap[parent];
+        idx = parent;
+    }
+    heap[idx] = entry;
+}
+
+static Nav_Heap_Entry
+pop_nav_heap(Nav_Heap_Entry *heap, u32 *count) {
+    Nav_Heap_Entry result = heap[0];
+    Nav_Heap_Entry last = heap[--(*count)];
+
+    u32 idx = 0;
+    for(;;) {
+        u32 child = idx * 2 + 1;
+        if(child >= *count) break;
+        if(child + 1 < *count && heap[child + 1].cost < heap[child].cost) child += 1;
+        if(last.cost <= heap[child].cost) break;
+        heap[idx] = heap[child];
+        idx = child;
+    }
+    heap[idx] = last;
+
+    return result;
+}
+
+// Points every node at the cheapest link toward goal. Nodes can be pushed once
+// per incoming link, so the heap never outgrows the link count.
+static void
+compute_nav_flow(Nav_Graph *nav, u16 goal) {
+    f64 start_time = sys_get_time();
+
+    for(u32 node = 0; node < nav->node_count; node++) {
+        nav->flow_link[node] = UINT32_MAX;
+        nav->flow_cost[node] = INFINITY;
+    }
+    nav->goal = goal;
+    nav->flow_cost[goal] = 0.f;
+
+    u32 heap_count = 0;
+    push_nav_heap(nav->heap, &heap_count, {0.f, goal});
+    while(heap_count > 0) {
+        Nav_Heap_Entry entry = pop_nav_heap(nav->heap, &heap_count);
+        if(entry.cost > nav->flow_cost[entry.node]) continue; // Stale
+
+        for(u32 in = nav->in_start[entry.node]; in < nav->in_start[entry.node + 1]; in++) {
+            u32 link_index = nav->in_links[in];
+            Nav_Link *link = &nav->links[link_index];
+            f32 cost = entry.cost + link->cost;
+            if(cost < nav->flow_cost[link->from]) {
+                nav->flow_cost[link->from] = cost;
+                nav->flow_link[link->from] = link_index;
+                push_nav_heap(nav->heap, &heap_count, {cost, link->from});
+            }
+        }
+    }
+
+    g_nav_stats.flow_updates += 1;
+    g_nav_stats.flow_ms = (f32)((sys_get_time() - start_time) * 1000.0);
+}
+
+// Called every tick with the ground the player stands on, 0 while airborne.
+// Airborne keeps the field of the platform the player left.
+static void
+update_nav_goal(Nav_Graph *nav, Entity_List *entity_list, Entity_ID player_ground) {
+    if(nav->dirty) {
+        build_nav_graph(nav, entity_list);
+    }
+
+    u16 node = get_nav_node(nav, player_ground);
+    if(node != NAV_NONE && node != nav->goal) {
+        compute_nav_flow(nav, node);
+    }
+}
+
+// The link a mover standing on ground should take toward the goal, nullptr
+// if it's already there or can't get there
+static Nav_Link*
+get_nav_flow(Nav_Graph *nav, Entity_ID ground) {
+    u16 node = get_nav_node(nav, ground);
+    if(node == NAV_NONE || nav->goal == NAV_NONE || node == nav->goal) return nullptr;
+    if(nav->flow_link[node] == UINT32_MAX) return nullptr;
+    return &nav->links[nav->flow_link[node]];
+}
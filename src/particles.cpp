@@ -0,0 +1,174 @@
+
+// Cosmetic particles for explosions and impacts. They live in their own SoA
+// pool outside the entity list, are integrated four at a time with SSE2 and
+// never interact with anything. Drawing rasterizes the visible ones into a
+// one pixel per world unit buffer the size of the camera view, which is
+// uploaded and drawn as a single textured quad.
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define PARTICLES_SSE 1
+#endif
+
+static constexpr u32 MAX_PARTICLE_COUNT = 256*1024;
+static constexpr f32 PARTICLE_GRAVITY = 0.05f;
+static constexpr f32 PARTICLE_DRAG = 0.96f;
+
+struct Particle_Pool {
+    u32 count;
+    f32 *pos_x;
+    f32 *pos_y;
+    f32 *vel_x;
+    f32 *vel_y;
+    f32 *life; // Ticks left
+    Color *color;
+};
+static Particle_Pool g_particles;
+
+struct Particle_Layer {
+    s32 width;
+    s32 height;
+    Color *pixels;
+    Texture2D texture;
+};
+static Particle_Layer g_particle_layer;
+
+struct Particle_Stats {
+    f32 tick_ms;
+    f32 draw_ms;
+    u32 drawn;
+};
+static Particle_Stats g_particle_stats;
+
+// Kept apart from g_rand_state so effects don't change what the game rolls
+static Rand_State g_particle_rand = {0x9e3779b97f4a7c15ull};
+
+static void
+init_particle_pool(Particle_Pool *pool, Allocator *allocator) {
+    pool->count = 0;
+    pool->pos_x = (f32*)alloc_raw(allocator, sizeof(f32)*MAX_PARTICLE_COUNT, 64);
+    pool->pos_y = (f32*)alloc_raw(allocator, sizeof(f32)*MAX_PARTICLE_COUNT, 64);
+    pool->vel_x = (f32*)alloc_raw(allocator, sizeof(f32)*MAX_PARTICLE_COUNT, 64);
+    pool->vel_y = (f32*)alloc_raw(allocator, sizeof(f32)*MAX_PARTICLE_COUNT, 64);
+    pool->life = (f32*)alloc_raw(allocator, sizeof(f32)*MAX_PARTICLE_COUNT, 64);
+    pool->color = (Color*)alloc_raw(allocator, sizeof(Color)*MAX_PARTICLE_COUNT, 64);
+}
+
+static void
+init_particle_layer(Particle_Layer *layer, Allocator *allocator, s32 width, s32 height) {
+    layer->width = width;
+    layer->height = height;
+    layer->pixels = alloc_array(allocator, Color, width*height);
+
+    Image image = GenImageColor(width, height, BLANK);
+    layer->texture = g_backend->load_texture_from_image(image);
+    UnloadImage(image);
+}
+
+inline static f32
+particle_rand(f32 min, f32 max) {
+    return min + (max - min) * (f32)(get_rand(&g_particle_rand) & 0xffff) / 65535.f;
+}
+
+static void
+emit_particle_burst(Particle_Pool *pool, Vector2 pos, u32 count, f32 speed, u32 lifetime_ticks, Color color) {
+    if(pool->count + count > MAX_PARTICLE_COUNT) {
+        count = MAX_PARTICLE_COUNT - pool->count;
+    }
+
+    for(u32 i = 0; i < count; i++) {
+        u32 idx = pool->count++;
+        f32 angle = particle_rand(0.f, 2.f * PI);
+        f32 magnitude = particle_rand(0.2f, 1.f) * speed;
+
+        pool->pos_x[idx] = pos.x;
+        pool->pos_y[idx] = pos.y;
+        pool->vel_x[idx] = cosf(angle) * magnitude;
+        pool->vel_y[idx] = sinf(angle) * magnitude;
+        pool->life[idx] = particle_rand(0.5f, 1.f) * lifetime_ticks;
+        pool->color[idx] = color;
+    }
+}
+
+static void
+integrate_particles(Particle_Pool *pool) {
+    u32 count = pool->count;
+    u32 idx = 0;
+
+#ifdef PARTICLES_SSE
+    __m128 gravity = _mm_set1_ps(PARTICLE_GRAVITY);
+    __m128 drag = _mm_set1_ps(PARTICLE_DRAG);
+    __m128 one = _mm_set1_ps(1.f);
+    for(; idx + 4 <= count; idx += 4) {
+        __m128 vx = _mm_mul_ps(_mm_load_ps(pool->vel_x + idx), drag);
+        __m128 vy = _mm_add_ps(_mm_mul_ps(_mm_load_ps(pool->vel_y + idx), drag), gravity);
+        _mm_store_ps(pool->vel_x + idx, vx);
+        _mm_store_ps(pool->vel_y + idx, vy);
+        _mm_store_ps(pool->pos_x + idx, _mm_add_ps(_mm_load_ps(pool->pos_x + idx), vx));
+        _mm_store_ps(pool->pos_y + idx, _mm_add_ps(_mm_load_ps(pool->pos_y + idx), vy));
+        _mm_store_ps(pool->life + idx, _mm_sub_ps(_mm_load_ps(pool->life + idx), one));
+    }
+#endif
+
+    for(; idx < count; idx++) {
+        pool->vel_x[idx] *= PARTICLE_DRAG;
+        pool->vel_y[idx] = pool->vel_y[idx] * PARTICLE_DRAG + PARTICLE_GRAVITY;
+        pool->pos_x[idx] += pool->vel_x[idx];
+        pool->pos_y[idx] += pool->vel_y[idx];
+        pool->life[idx] -= 1.f;
+    }
+}
+
+static void
+tick_particles(Particle_Pool *pool) {
+    f64 start_time = sys_get_time();
+
+    integrate_particles(pool);
+
+    u32 alive = 0;
+    for(u32 idx = 0; idx < pool->count; idx++) {
+        if(pool->life[idx] <= 0.f) continue;
+
+        if(alive != idx) {
+            pool->pos_x[alive] = pool->pos_x[idx];
+            pool->pos_y[alive] = pool->pos_y[idx];
+            pool->vel_x[alive] = pool->vel_x[idx];
+            pool->vel_y[alive] = pool->vel_y[idx];
+            pool->life[alive] = pool->life[idx];
+            pool->color[alive] = pool->color[idx];
+        }
+        alive += 1;
+    }
+    pool->count = alive;
+
+    g_particle_stats.tick_ms = (f32)((sys_get_time() - start_time) * 1000.0);
+}
+
+static void
+draw_particles(Render_List *render, Particle_Pool *pool, Particle_Layer *layer, Rectangle view) {
+    f64 start_time = sys_get_time();
+
+    f32 origin_x = floorf(view.x);
+    f32 origin_y = floorf(view.y);
+    s32 width = layer->width;
+    s32 height = layer->height;
+    memset(layer->pixels, 0, sizeof(Color)*width*height);
+
+    u32 drawn = 0;
+    for(u32 idx = 0; idx < pool->count; idx++) {
+        s32 px = (s32)(pool->pos_x[idx] - origin_x);
+        s32 py = (s32)(pool->pos_y[idx] - origin_y);
+        if((u32)px >= (u32)width || (u32)py >= (u32)height) continue;
+
+        layer->pixels[py*width + px] = pool->color[idx];
+        drawn += 1;
+    }
+
+    if(drawn > 0) {
+        push_texture_update(render, RENDER_LAYER_PARTICLES, 0, layer->texture, layer->pixels, sizeof(Color)*width*height);
+        push_texture_rec(render, RENDER_LAYER_PARTICLES, 1, layer->texture, {0, 0, (f32)width, (f32)height}, {origin_x, origin_y}, WHITE);
+    }
+
+    g_particle_stats.drawn = drawn;
+    g_particle_stats.draw_ms = (f32)((sys_get_time() - start_time) * 1000.0);
+}
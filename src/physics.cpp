@@ -0,0 +1,214 @@
+
+// Swept kinematic character controller. Movers are swept one axis at a time
+// against the static terrain (ground, closed doors, stationary solids), so they
+// stop at the contact point instead of being pushed out after the fact.
+
+static constexpr s32 MAX_TERRAIN_COUNT = 4096;
+static constexpr f32 STEP_HEIGHT = 12.f;
+static constexpr f32 GROUND_PROBE = 1.f;
+static constexpr f32 CONTACT_EPSILON = 0.001f;
+
+struct Terrain_Rect {
+    Rectangle bounds;
+    Entity_ID id;
+};
+
+struct Terrain {
+    u32 count;
+    f32 max_width;
+    bool dirty;
+    Terrain_Rect rects[MAX_TERRAIN_COUNT]; // Sorted by bounds.x
+};
+static Terrain *g_terrain;
+
+inline static bool
+is_terrain(Entity *entity) {
+    return (entity->phys_state == PHYS_STATE_STATIONARY &&
+            (entity->flags & (ENTITY_FLAG_NO_COLLIDE | ENTITY_FLAG_PICKUP)) == 0);
+}
+
+// Needs to be called whenever a stationary entity starts or stops colliding
+static void
+mark_terrain_dirty() {
+    g_terrain->dirty = true;
+}
+
+static int
+compare_terrain_rects(const void *a, const void *b) {
+    f32 ax = ((Terrain_Rect*)a)->bounds.x;
+    f32 bx = ((Terrain_Rect*)b)->bounds.x;
+    return (ax < bx) ? -1 : (ax > bx);
+}
+
+static void
+build_terrain(Terrain *terrain, Entity_List *entity_list) {
+    terrain->count = 0;
+    terrain->max_width = 0.f;
+
+    for(s32 entity_index = 0; entity_index < entity_list->entity_count; entity_index++) {
+        Entity *entity = &entity_list->entities[entity_index];
+        if(!is_terrain(entity)) continue;
+
+        d_assert(terrain->count < MAX_TERRAIN_COUNT);
+        if(terrain->count >= MAX_TERRAIN_COUNT) break;
+
+        Terrain_Rect *rect = &terrain->rects[terrain->count++];
+        rect->bounds = get_bounds(entity);
+        rect->id = entity->id;
+        if(rect->bounds.width > terrain->max_width) terrain->max_width = rect->bounds.width;
+    }
+
+    qsort(terrain->rects, terrain->count, sizeof(Terrain_Rect), compare_terrain_rects);
+    terrain->dirty = false;
+}
+
+// Returns the index range [*first, *last) of terrain rects that may overlap area on x
+static void
+query_terrain(Terrain *terrain, Rectangle area, u32 *first, u32 *last) {
+    f32 min_x = area.x - terrain->max_width;
+    f32 max_x = area.x + area.width;
+
+    u32 lo = 0, hi = terrain->count;
+    while(lo < hi) {
+        u32 mid = (lo + hi) / 2;
+        if(terrain->rects[mid].bounds.x < min_x) lo = mid + 1; else hi = mid;
+    }
+    *first = lo;
+
+    hi = terrain->count;
+    while(lo < hi) {
+        u32 mid = (lo + hi) / 2;
+        if(terrain->rects[mid].bounds.x <= max_x) lo = mid + 1; else hi = mid;
+    }
+    *last = lo;
+}
+
+// How far box can travel along x before touching terrain. Rects the box
+// already overlaps are ignored so a mover can always get itself out.
+static f32
+sweep_x(Terrain *terrain, Rectangle box, f32 dx, Entity_ID *hit) {
+    if(dx == 0.f) return 0.f;
+
+    Rectangle area = box;
+    if(dx < 0.f) area.x += dx;
+    area.width += fabsf(dx);
+
+    u32 first, last;
+    query_terrain(terrain, area, &first, &last);
+    for(u32 idx = first; idx < last; idx++) {
+        Rectangle r = terrain->rects[idx].bounds;
+        if(r.y >= box.y + box.height || r.y + r.height <= box.y) continue;
+
+        if(dx > 0.f) {
+            f32 gap = r.x - (box.x + box.width);
+            if(gap >= -CONTACT_EPSILON && gap < dx) {
+                dx = (gap > 0.f) ? gap : 0.f;
+                if(hit) *hit = terrain->rects[idx].id;
+            }
+        } else {
+            f32 gap = (r.x + r.width) - box.x;
+            if(gap <= CONTACT_EPSILON && gap > dx) {
+                dx = (gap < 0.f) ? gap : 0.f;
+                if(hit) *hit = terrain->rects[idx].id;
+            }
+        }
+    }
+
+    return dx;
+}
+
+static f32
+sweep_y(Terrain *terrain, Rectangle box, f32 dy, Entity_ID *hit) {
+    if(dy == 0.f) return 0.f;
+
+    u32 first, last;
+    query_terrain(terrain, box, &first, &last);
+    for(u32 idx = first; idx < last; idx++) {
+        Rectangle r = terrain->rects[idx].bounds;
+        if(r.x >= box.x + box.width || r.x + r.width <= box.x) continue;
+
+        if(dy > 0.f) {
+            f32 gap = r.y - (box.y + box.height);
+            if(gap >= -CONTACT_EPSILON && gap < dy) {
+                dy = (gap > 0.f) ? gap : 0.f;
+                if(hit) *hit = terrain->rects[idx].id;
+            }
+        } else {
+            f32 gap = (r.y + r.height) - box.y;
+            if(gap <= CONTACT_EPSILON && gap > dy) {
+                dy = (gap < 0.f) ? gap : 0.f;
+                if(hit) *hit = terrain->rects[idx].id;
+            }
+        }
+    }
+
+    return dy;
+}
+
+// Moves the entity by its velocity with slide and step resolution, then
+// applies gravity. Ground contact is re-probed every tick, so nothing holds on
+// to the entity it is standing on. steps > 1 catches up on skipped ticks.
+static void
+move_kinematic(Terrain *terrain, Entity *entity, u32 steps = 1) {
+    // Airborne movers integrate every missed tick, grounded ones take one long sweep
+    if(steps > 1 && entity->phys_state != PHYS_STATE_STANDING) {
+        for(u32 step = 0; step < steps; step++) {
+            move_kinematic(terrain, entity);
+        }
+        return;
+    }
+
+    Vector2 delta = mul_vec2_f(entity->velocity, 2.f * steps);
+    Rectangle box = get_bounds(entity);
+    Entity_ID hit = 0;
+
+    // Horizontal, stepping up onto ledges lower than STEP_HEIGHT when grounded
+    f32 dx = sweep_x(terrain, box, delta.x, nullptr);
+    if(dx != delta.x && entity->phys_state == PHYS_STATE_STANDING) {
+        Rectangle raised = box;
+        raised.y += sweep_y(terrain, box, -STEP_HEIGHT, nullptr);
+
+        f32 step_dx = sweep_x(terrain, raised, delta.x, nullptr);
+        if(fabsf(step_dx) > fabsf(dx)) {
+            raised.x += step_dx;
+            raised.y += sweep_y(terrain, raised, box.y - raised.y, nullptr);
+            box.y = raised.y;
+            dx = step_dx;
+        }
+    }
+    box.x += dx;
+    if(dx != delta.x) {
+        entity->velocity.x = 0.f;
+    }
+
+    // Vertical
+    f32 dy = sweep_y(terrain, box, delta.y, &hit);
+    box.y += dy;
+    if(dy != delta.y) {
+        entity->velocity.y = 0.f;
+        if(delta.y > 0.f) {
+            entity->phys_state = PHYS_STATE_STANDING;
+            entity->ground = hit;
+        }
+    } else if(entity->phys_state == PHYS_STATE_STANDING) {
+        f32 probe = sweep_y(terrain, box, GROUND_PROBE, &hit);
+        if(probe == GROUND_PROBE) {
+            entity->phys_state = PHYS_STATE_FALLING;
+            entity->ground = 0;
+        } else {
+            box.y += probe;
+            entity->ground = hit;
+        }
+    }
+
+    entity->pos.x = box.x - entity->collision_rec.x;
+    entity->pos.y = box.y - entity->collision_rec.y;
+
+    if(is_falling(entity->phys_state) && entity->velocity.y < TERMINAL_VELOCITY) {
+        entity->velocity.y += 0.15f;
+
+        if(entity->velocity.y >= 0.f) {
+            entity->phys_state = PHYS_STATE_FALLING;
+        }
+    }
+}
@@ -0,0 +1,151 @@
+
+// Projectiles live outside the entity list in structure-of-arrays pools. A
+// tick integrates every projectile in one flat loop, then hit tests them
+// against the spatial grid and compacts the survivors in the same pass,
+// keeping spawn order without swapping.
+//
+// Every projectile is touched each tick anyway, so expiry is a compare in the
+// compaction pass rather than a timer per projectile.
+
+static constexpr u32 MAX_PROJECTILE_COUNT = 128*1024;
+static constexpr f32 PROJECTILE_RADIUS = 8.f;
+static constexpr f32 PROJECTILE_SPEED = 20.f;
+static constexpr f32 PROJECTILE_DAMAGE = 25.f;
+
+struct Projectile_Pool {
+    u32 count;
+    f32 *pos_x;
+    f32 *pos_y;
+    f32 *vel_x;
+    f32 *vel_y;
+    u32 *expire_tick;
+    Entity_ID *shooter;
+    u32 *ignore_flags; // Entities with any of these flags are passed through
+};
+static Projectile_Pool g_projectiles;
+
+struct Projectile_Stats {
+    u32 spawned;
+    u32 hits;
+    f32 tick_ms;
+};
+static Projectile_Stats g_projectile_stats;
+
+static void
+init_projectile_pool(Projectile_Pool *pool, Allocator *allocator) {
+    pool->count = 0;
+    pool->pos_x = (f32*)alloc_raw(allocator, sizeof(f32)*MAX_PROJECTILE_COUNT, 64);
+    pool->pos_y = (f32*)alloc_raw(allocator, sizeof(f32)*MAX_PROJECTILE_COUNT, 64);
+    pool->vel_x = (f32*)alloc_raw(allocator, sizeof(f32)*MAX_PROJECTILE_COUNT, 64);
+    pool->vel_y = (f32*)alloc_raw(allocator, sizeof(f32)*MAX_PROJECTILE_COUNT, 64);
+    pool->expire_tick = (u32*)alloc_raw(allocator, sizeof(u32)*MAX_PROJECTILE_COUNT, 64);
+    pool->shooter = (Entity_ID*)alloc_raw(allocator, sizeof(Entity_ID)*MAX_PROJECTILE_COUNT, 64);
+    pool->ignore_flags = (u32*)alloc_raw(allocator, sizeof(u32)*MAX_PROJECTILE_COUNT, 64);
+}
+
+static bool
+spawn_projectile(Projectile_Pool *pool, Vector2 pos, Vector2 velocity, Entity_ID shooter, u32 ignore_flags, u32 lifetime_ticks) {
+    if(pool->count >= MAX_PROJECTILE_COUNT) return false;
+
+    u32 idx = pool->count++;
+    pool->pos_x[idx] = pos.x;
+    pool->pos_y[idx] = pos.y;
+    pool->vel_x[idx] = velocity.x;
+    pool->vel_y[idx] = velocity.y;
+    pool->expire_tick[idx] = g_timers->tick + lifetime_ticks;
+    pool->shooter[idx] = shooter;
+    pool->ignore_flags[idx] = ignore_flags;
+    g_projectile_stats.spawned += 1;
+    return true;
+}
+
+inline static bool
+circle_overlaps_rec(f32 cx, f32 cy, f32 radius, Rectangle rec) {
+    f32 nx = (cx < rec.x) ? rec.x : (cx > rec.x + rec.width) ? rec.x + rec.width : cx;
+    f32 ny = (cy < rec.y) ? rec.y : (cy > rec.y + rec.height) ? rec.y + rec.height : cy;
+    f32 dx = cx - nx;
+    f32 dy = cy - ny;
+    return (dx*dx + dy*dy <= radius*radius);
+}
+
+// First collidable entity the projectile overlaps, or nullptr
+static Entity*
+find_projectile_hit(Spatial_Grid *grid, Entity_List *entity_list, f32 x, f32 y, Entity_ID shooter, u32 ignore_flags) {
+    s32 cx0 = get_grid_coord(x - PROJECTILE_RADIUS), cx1 = get_grid_coord(x + PROJECTILE_RADIUS);
+    s32 cy0 = get_grid_coord(y - PROJECTILE_RADIUS), cy1 = get_grid_coord(y + PROJECTILE_RADIUS);
+
+    for(s32 cy = cy0; cy <= cy1; cy++) {
+        for(s32 cx = cx0; cx <= cx1; cx++) {
+            u32 *entries;
+            u32 entry_count = get_grid_cell(grid, cx, cy, &entries);
+            for(u32 i = 0; i < entry_count; i++) {
+                Entity *entity = &entity_list->entities[entries[i]];
+                if(entity->id == shooter || (entity->flags & (ENTITY_FLAG_NO_COLLIDE | ignore_flags))) continue;
+
+                if(circle_overlaps_rec(x, y, PROJECTILE_RADIUS, get_bounds(entity))) {
+                    return entity;
+                }
+            }
+        }
+    }
+
+    return nullptr;
+}
+
+// The grid has to be built from the entity list as it is this tick. Hits are
+// pushed to the damage buffer and resolved by the caller.
+static void
+tick_projectiles(Projectile_Pool *pool, Spatial_Grid *grid, Entity_List *entity_list, Damage_Buffer *damage) {
+    f64 start_time = sys_get_time();
+    u32 count = pool->count;
+
+    f32 *pos_x = pool->pos_x;
+    f32 *pos_y = pool->pos_y;
+    f32 *vel_x = pool->vel_x;
+    f32 *vel_y = pool->vel_y;
+    for(u32 idx = 0; idx < count; idx++) {
+        pos_x[idx] += vel_x[idx];
+        pos_y[idx] += vel_y[idx];
+    }
+
+    u32 tick = g_timers->tick;
+    u32 alive = 0;
+    for(u32 idx = 0; idx < count; idx++) {
+        if(pool->expire_tick[idx] <= tick) continue;
+
+        Entity *hit = find_projectile_hit(grid, entity_list, pos_x[idx], pos_y[idx], pool->shooter[idx], pool->ignore_flags[idx]);
+        if(hit) {
+            push_damage_event(damage, hit, PROJECTILE_DAMAGE);
+            emit_particle_burst(&g_particles, {pos_x[idx], pos_y[idx]}, 6, 1.5f, 15, YELLOW);
+            g_projectile_stats.hits += 1;
+            continue;
+        }
+
+        if(alive != idx) {
+            pos_x[alive] = pos_x[idx];
+            pos_y[alive] = pos_y[idx];
+            vel_x[alive] = vel_x[idx];
+            vel_y[alive] = vel_y[idx];
+            pool->expire_tick[alive] = pool->expire_tick[idx];
+            pool->shooter[alive] = pool->shooter[idx];
+            pool->ignore_flags[alive] = pool->ignore_flags[idx];
+        }
+        alive += 1;
+    }
+    pool->count = alive;
+
+    g_projectile_stats.tick_ms = (f32)((sys_get_time() - start_time) * 1000.0);
+}
+
+static void
+draw_projectiles(Render_List *render, Projectile_Pool *pool, Rectangle view) {
+    // Lines trail 2.5 ticks of travel, a player shot's original 50 units
+    Rectangle area = expand_rec(view, PROJECTILE_SPEED * 2.5f);
+    for(u32 idx = 0; idx < pool->count; idx++) {
+        Vector2 pos = {pool->pos_x[idx], pool->pos_y[idx]};
+        if(pos.x < area.x || pos.x > area.x + area.width || pos.y < area.y || pos.y > area.y + area.height) continue;
+
+        Vector2 tail = add_vec2(pos, mul_vec2_f({pool->vel_x[idx], pool->vel_y[idx]}, 2.5f));
+        push_line(render, RENDER_LAYER_PROJECTILES, 0, pos, tail, 0.5f, YELLOW);
+    }
+}
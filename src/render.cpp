@@ -0,0 +1,461 @@
+
+// Sorted draw list. Everything drawn in a frame is pushed as a draw item with
+// a 64 bit key, the keys are radix sorted and the items executed in key order:
+//
+//   layer:8 | texture:16 | depth:16 | sequence:24
+//
+// Layers give a fixed stacking order whatever order things were pushed in.
+// Within a layer items are grouped by texture so raylib can batch them, depth
+// orders items within a texture and the push sequence keeps equal keys stable
+// (and is how a key finds its item again). The background and layers from
+// RENDER_LAYER_SCREEN on are drawn in screen space, the rest through the camera.
+//
+// With a world target (-lowres) the background and world layers are drawn
+// into a render texture 1/scale the size of the screen, through the camera
+// scaled down to match, and the texture is stretched over the screen by a
+// whole factor before the screen layers, which stay at full resolution. At the
+// game's zoom of 4 that's one texel per world unit. The world can also be
+// drawn into just the top left resolution fraction of the target and that
+// stretched over the screen instead, which is how the resolution governor
+// (-dynres) sheds fill cost.
+//
+// A list is a complete record of a frame: draws, texture uploads, offscreen
+// passes and the sounds started that frame, with strings and pixels copied
+// into its own data buffer. The simulation thread fills one list while the
+// main thread submits the other, only the main thread talks to raylib's
+// renderer and audio. RENDER_LAYER_OFFSCREEN holds passes into render
+// textures, run before anything is drawn to the screen. Its keys have the pass
+// number in place of the texture, so each pass's DRAW_TARGET item and then
+// its draws come out together.
+
+static constexpr u32 MAX_DRAW_ITEMS = 256*1024;
+static constexpr u32 MAX_DRAW_DATA = 512*1024;
+static constexpr u32 MAX_FRAME_SOUNDS = 32;
+
+enum {
+    RENDER_LAYER_OFFSCREEN,
+    RENDER_LAYER_BACKGROUND,
+    RENDER_LAYER_GROUND,
+    RENDER_LAYER_PROPS,
+    RENDER_LAYER_ACTORS,
+    RENDER_LAYER_PLAYER,
+    RENDER_LAYER_PROJECTILES,
+    RENDER_LAYER_PARTICLES,
+
+    RENDER_LAYER_SCREEN,
+    RENDER_LAYER_DIALOG = RENDER_LAYER_SCREEN,
+    RENDER_LAYER_HUD,
+    RENDER_LAYER_DEBUG,
+    RENDER_LAYER_CURSOR,
+    RENDER_LAYER_COUNT
+};
+
+enum {
+    DRAW_TEXTURE,
+    DRAW_TEXTURE_QUAD,
+    DRAW_LINE,
+    DRAW_RECT,
+    DRAW_TEXT,
+    DRAW_TARGET,
+    DRAW_UPDATE_TEXTURE,
+};
+
+struct Draw_Item {
+    u8 type;
+    Texture2D texture;
+    RenderTexture2D *target;
+    Rectangle src;  // Quad: tiling in x, y and offset in width, height. Line: start in x, y and end in width, height.
+    Rectangle dest; // Text: position in x, y and font size in width. Target: camera target in x, y.
+    f32 thickness;
+    Color color;
+    u32 data; // Offset into Render_List::data of text or pixels
+};
+
+struct Render_Stats {
+    u32 items;
+    u32 batches; // Runs of items sharing a texture and camera, raylib's texture binds
+    u32 draw_calls; // Items that draw, not uploads or passes
+    u32 sprites; // Textured draws
+    u32 target_switches; // Offscreen passes and the world target
+    u32 texture_updates;
+    u32 layer_items[RENDER_LAYER_COUNT];
+    f32 world_resolution; // Of the world target, 1 without one
+    f32 sort_ms;
+    f32 execute_ms;
+    f32 present_ms; // In the backend's end_frame, filled in by the caller
+};
+static Render_Stats g_render_stats; // Of the last list submitted
+
+struct Render_List {
+    u32 count;
+    u32 data_used;
+    u16 pass_count;
+    u64 *keys;
+    u64 *sort_keys;
+    Draw_Item *items;
+    u8 *data;
+
+    Camera2D camera;
+    f64 input_time; // Oldest input first simulated in this frame, 0 if none
+    u32 sound_count;
+    u8 sounds[MAX_FRAME_SOUNDS];
+    Render_Stats stats; // Filled in by execute_render_list
+};
+static Render_List g_render_lists[2];
+static Render_List *g_frame_render; // The one the frame being simulated pushes to
+
+struct World_Target {
+    bool enabled;
+    s32 scale; // Screen pixels per target texel
+    f32 resolution; // Fraction of the target drawn to, on the main thread
+    RenderTexture2D target;
+};
+static World_Target g_world_target;
+
+// Needs the window
+static void
+init_world_target(World_Target *world, s32 scale) {
+    world->enabled = true;
+    world->scale = scale;
+    world->resolution = 1.f;
+    world->target = g_backend->load_render_texture(SCREEN_WIDTH / scale, SCREEN_HEIGHT / scale);
+}
+
+static void
+init_render_list(Render_List *list, Allocator *allocator) {
+    *list = {};
+    list->keys = (u64*)alloc_raw(allocator, sizeof(u64)*MAX_DRAW_ITEMS, 64);
+    list->sort_keys = (u64*)alloc_raw(allocator, sizeof(u64)*MAX_DRAW_ITEMS, 64);
+    list->items = alloc_array(allocator, Draw_Item, MAX_DRAW_ITEMS);
+    list->data = (u8*)alloc_raw(allocator, MAX_DRAW_DATA, 64);
+}
+
+// Returns nullptr when the data buffer is full
+static void*
+push_draw_data(Render_List *list, u32 size) {
+    u32 offset = (u32)align_up(list->data_used, 16);
+    if(offset + size > MAX_DRAW_DATA) return nullptr;
+    list->data_used = offset + size;
+    return list->data + offset;
+}
+
+inline static bool
+is_world_layer(u8 layer) {
+    return (layer > RENDER_LAYER_BACKGROUND && layer < RENDER_LAYER_SCREEN);
+}
+
+inline static u64
+make_draw_key(u8 layer, u32 texture_id, u16 depth, u32 sequence) {
+    return ((u64)layer << 56) | ((u64)(texture_id & 0xffff) << 40) | ((u64)depth << 24) | (sequence & 0xffffff);
+}
+
+// Returns nullptr when the list is full, the item is dropped
+static Draw_Item*
+push_draw_item(Render_List *list, u8 layer, u32 texture_id, u16 depth) {
+    if(list->count >= MAX_DRAW_ITEMS) return nullptr;
+
+    u32 idx = list->count++;
+    if(layer == RENDER_LAYER_OFFSCREEN) texture_id = list->pass_count;
+    list->keys[idx] = make_draw_key(layer, texture_id, depth, idx);
+    return &list->items[idx];
+}
+
+static void
+push_texture(Render_List *list, u8 layer, u16 depth, Texture2D texture, Rectangle src, Rectangle dest, Color color) {
+    Draw_Item *item = push_draw_item(list, layer, texture.id, depth);
+    if(!item) return;
+    item->type = DRAW_TEXTURE;
+    item->texture = texture;
+    item->src = src;
+    item->dest = dest;
+    item->color = color;
+}
+
+// Same as DrawTextureRec
+static void
+push_texture_rec(Render_List *list, u8 layer, u16 depth, Texture2D texture, Rectangle src, Vector2 pos, Color color) {
+    push_texture(list, layer, depth, texture, src, {pos.x, pos.y, fabsf(src.width), fabsf(src.height)}, color);
+}
+
+static void
+push_texture_quad(Render_List *list, u8 layer, u16 depth, Texture2D texture, Vector2 tiling, Vector2 offset, Rectangle quad, Color color) {
+    Draw_Item *item = push_draw_item(list, layer, texture.id, depth);
+    if(!item) return;
+    item->type = DRAW_TEXTURE_QUAD;
+    item->texture = texture;
+    item->src = {tiling.x, tiling.y, offset.x, offset.y};
+    item->dest = quad;
+    item->color = color;
+}
+
+// Untextured shapes share texture slot 0 and sort together
+static void
+push_line(Render_List *list, u8 layer, u16 depth, Vector2 start, Vector2 end, f32 thickness, Color color) {
+    Draw_Item *item = push_draw_item(list, layer, 0, depth);
+    if(!item) return;
+    item->type = DRAW_LINE;
+    item->src = {start.x, start.y, end.x, end.y};
+    item->thickness = thickness;
+    item->color = color;
+}
+
+static void
+push_rect(Render_List *list, u8 layer, u16 depth, Rectangle rect, Color color) {
+    Draw_Item *item = push_draw_item(list, layer, 0, depth);
+    if(!item) return;
+    item->type = DRAW_RECT;
+    item->dest = rect;
+    item->color = color;
+}
+
+// Same as DrawText, the string is copied
+static void
+push_text(Render_List *list, u8 layer, u16 depth, const char *text, s32 x, s32 y, s32 size, Color color) {
+    u32 length = (u32)strlen(text) + 1;
+    char *copy = (char*)push_draw_data(list, length);
+    if(!copy) return;
+
+    Draw_Item *item = push_draw_item(list, layer, GetFontDefault().texture.id, depth);
+    if(!item) return;
+    item->type = DRAW_TEXT;
+    item->dest = {(f32)x, (f32)y, (f32)size, 0};
+    item->color = color;
+    item->data = (u32)((u8*)copy - list->data);
+    memcpy(copy, text, length);
+}
+
+// Starts an offscreen pass into target, cleared and with origin at the top
+// left. Items pushed to RENDER_LAYER_OFFSCREEN after it with a depth above 0
+// are drawn in the pass.
+static void
+push_target(Render_List *list, RenderTexture2D *target, Vector2 origin) {
+    list->pass_count += 1;
+    Draw_Item *item = push_draw_item(list, RENDER_LAYER_OFFSCREEN, 0, 0);
+    if(!item) return;
+    item->type = DRAW_TARGET;
+    item->target = target;
+    item->dest = {origin.x, origin.y, 0, 0};
+}
+
+// Same as UpdateTexture, the pixels are copied. Goes before draws of the
+// texture with the same layer and a lower depth.
+static void
+push_texture_update(Render_List *list, u8 layer, u16 depth, Texture2D texture, const void *pixels, u32 size) {
+    void *copy = push_draw_data(list, size);
+    if(!copy) return;
+
+    Draw_Item *item = push_draw_item(list, layer, texture.id, depth);
+    if(!item) return;
+    item->type = DRAW_UPDATE_TEXTURE;
+    item->texture = texture;
+    item->data = (u32)((u8*)copy - list->data);
+    memcpy(copy, pixels, size);
+}
+
+// Played by whoever submits the list
+static void
+push_sound(Render_List *list, u8 sound) {
+    if(list->sound_count < MAX_FRAME_SOUNDS) {
+        list->sounds[list->sound_count++] = sound;
+    }
+}
+
+// LSD radix sort, a byte per pass. Passes where every key has the same byte
+// are skipped, which is most of them: few layers, few textures.
+static void
+sort_draw_keys(Render_List *list) {
+    u64 *src = list->keys;
+    u64 *dst = list->sort_keys;
+    u32 count = list->count;
+
+    for(u32 shift = 0; shift < 64; shift += 8) {
+        u32 offsets[256] = {};
+        for(u32 idx = 0; idx < count; idx++) {
+            offsets[(src[idx] >> shift) & 0xff] += 1;
+        }
+        if(offsets[(src[0] >> shift) & 0xff] == count) continue;
+
+        u32 total = 0;
+        for(u32 bucket = 0; bucket < 256; bucket++) {
+            u32 bucket_count = offsets[bucket];
+            offsets[bucket] = total;
+            total += bucket_count;
+        }
+        for(u32 idx = 0; idx < count; idx++) {
+            dst[offsets[(src[idx] >> shift) & 0xff]++] = src[idx];
+        }
+
+        u64 *tmp = src;
+        src = dst;
+        dst = tmp;
+    }
+
+    // Sorted keys end up in keys whichever buffer the last pass wrote
+    if(src != list->keys) {
+        memcpy(list->keys, src, sizeof(u64)*count);
+    }
+}
+
+static void
+execute_draw_item(Render_List *list, Draw_Item *item) {
+    switch(item->type) {
+        case DRAW_TEXTURE: {
+            g_backend->draw_texture(item->texture, item->src, item->dest, item->color);
+        } break;
+        case DRAW_TEXTURE_QUAD: {
+            g_backend->draw_texture_quad(item->texture, {item->src.x, item->src.y}, {item->src.width, item->src.height}, item->dest, item->color);
+        } break;
+        case DRAW_LINE: {
+            g_backend->draw_line({item->src.x, item->src.y}, {item->src.width, item->src.height}, item->thickness, item->color);
+        } break;
+        case DRAW_RECT: {
+            g_backend->draw_rect(item->dest, item->color);
+        } break;
+        case DRAW_TEXT: {
+            g_backend->draw_text((char*)list->data + item->data, (s32)item->dest.x, (s32)item->dest.y, (s32)item->dest.width, item->color);
+        } break;
+        case DRAW_UPDATE_TEXTURE: {
+            g_backend->update_texture(item->texture, list->data + item->data);
+        } break;
+    }
+}
+
+// Size of the part of the world target drawn to
+inline static Vector2
+get_world_target_size(World_Target *world) {
+    Texture2D texture = world->target.texture;
+    return {floorf(texture.width * world->resolution), floorf(texture.height * world->resolution)};
+}
+
+// Ends the world target's texture mode and scales it over the screen.
+// Render textures are stored upside down, the drawn part is at the end.
+static void
+present_world_target(World_Target *world) {
+    g_backend->end_target();
+    Texture2D texture = world->target.texture;
+    Vector2 size = get_world_target_size(world);
+    g_backend->draw_texture(texture, {0, texture.height - size.y, size.x, -size.y},
+                            {0, 0, (f32)(texture.width * world->scale), (f32)(texture.height * world->scale)}, WHITE);
+}
+
+enum {
+    RENDER_SPACE_SCREEN,
+    RENDER_SPACE_WORLD,
+    RENDER_SPACE_TARGET, // Screen coordinates scaled into the world target
+    RENDER_SPACE_OFFSCREEN, // In a DRAW_TARGET pass
+};
+
+// Has to be called between the backend's begin_frame and end_frame, with the
+// list's camera set. world can be nullptr. Sounds are left for the caller.
+// Empties the list.
+static void
+execute_render_list(Render_List *list, World_Target *world) {
+    f64 start_time = sys_get_time();
+    if(list->count > 0) {
+        sort_draw_keys(list);
+    }
+    f64 sort_time = sys_get_time();
+
+    Camera2D camera = list->camera;
+    Camera2D target_camera = {};
+    target_camera.zoom = 1.f;
+    bool use_target = (world && world->enabled);
+    if(use_target) {
+        f32 scale = get_world_target_size(world).x / (world->target.texture.width * world->scale);
+        camera.offset = mul_vec2_f(camera.offset, scale);
+        camera.zoom *= scale;
+        target_camera.zoom = scale;
+    }
+
+    Render_Stats stats = {};
+    bool in_target = false;
+    u8 space = RENDER_SPACE_SCREEN;
+    u64 batch_key = UINT64_MAX;
+    for(u32 idx = 0; idx < list->count; idx++) {
+        u64 key = list->keys[idx];
+        u8 layer = (u8)(key >> 56);
+        Draw_Item *item = &list->items[key & 0xffffff];
+
+        if(item->type == DRAW_TARGET) {
+            if(space != RENDER_SPACE_SCREEN) g_backend->end_camera();
+            if(space == RENDER_SPACE_OFFSCREEN) g_backend->end_target();
+
+            Camera2D pass_camera = {};
+            pass_camera.target = {item->dest.x, item->dest.y};
+            pass_camera.zoom = 1.f;
+            g_backend->begin_target(item->target, BLANK);
+            g_backend->begin_camera(pass_camera);
+            space = RENDER_SPACE_OFFSCREEN;
+            batch_key = UINT64_MAX;
+            stats.target_switches += 1;
+            continue;
+        }
+        if(space == RENDER_SPACE_OFFSCREEN && layer != RENDER_LAYER_OFFSCREEN) {
+            g_backend->end_camera();
+            g_backend->end_target();
+            space = RENDER_SPACE_SCREEN;
+        }
+
+        if(use_target && !in_target && layer >= RENDER_LAYER_BACKGROUND) {
+            if(space != RENDER_SPACE_SCREEN) g_backend->end_camera();
+            space = RENDER_SPACE_SCREEN;
+            g_backend->begin_target(&world->target, BLACK);
+            in_target = true;
+            stats.target_switches += 1;
+        }
+        if(in_target && layer >= RENDER_LAYER_SCREEN) {
+            if(space != RENDER_SPACE_SCREEN) g_backend->end_camera();
+            space = RENDER_SPACE_SCREEN;
+            present_world_target(world);
+            in_target = false;
+            use_target = false;
+        }
+
+        bool world_layer = is_world_layer(layer);
+        if(space != RENDER_SPACE_OFFSCREEN) {
+            u8 item_space = world_layer ? RENDER_SPACE_WORLD : (in_target ? RENDER_SPACE_TARGET : RENDER_SPACE_SCREEN);
+            if(item_space != space) {
+                if(space != RENDER_SPACE_SCREEN) g_backend->end_camera();
+                if(item_space == RENDER_SPACE_WORLD) g_backend->begin_camera(camera);
+                if(item_space == RENDER_SPACE_TARGET) g_backend->begin_camera(target_camera);
+                space = item_space;
+            }
+        }
+
+        u64 texture_key = ((key >> 40) & 0xffff) | ((u64)space << 16);
+        if(texture_key != batch_key) {
+            batch_key = texture_key;
+            stats.batches += 1;
+        }
+
+        execute_draw_item(list, item);
+        stats.layer_items[layer] += 1;
+        if(item->type == DRAW_UPDATE_TEXTURE) {
+            stats.texture_updates += 1;
+        } else {
+            stats.draw_calls += 1;
+            if(item->type == DRAW_TEXTURE || item->type == DRAW_TEXTURE_QUAD) stats.sprites += 1;
+        }
+    }
+    if(space != RENDER_SPACE_SCREEN) {
+        g_backend->end_camera();
+    }
+    if(space == RENDER_SPACE_OFFSCREEN) {
+        g_backend->end_target();
+    }
+    if(in_target) {
+        present_world_target(world);
+    }
+
+    stats.items = list->count;
+    stats.world_resolution = (world && world->enabled) ? world->resolution : 1.f;
+    stats.sort_ms = (f32)((sort_time - start_time) * 1000.0);
+    stats.execute_ms = (f32)((sys_get_time() - sort_time) * 1000.0);
+    list->stats = stats;
+
+    list->count = 0;
+    list->data_used = 0;
+    list->pass_count = 0;
+    list->sound_count = 0;
+    list->input_time = 0.0;
+}
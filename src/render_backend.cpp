@@ -0,0 +1,279 @@
+
+// Renderer backends. Render lists are executed and assets loaded through
+// g_backend, never by calling raylib's renderer directly, so the game can run
+// without a window or GPU:
+//
+//   raylib  draws, the default
+//   null    does nothing, textures get ids and sizes but no pixels
+//   record  counts draw calls, texture switches and vertices, then passes
+//           everything on to null
+//   soft    rasterizes on the CPU into a memory framebuffer, see
+//           soft_renderer.cpp
+//
+// Textures from the null and record backends read the image file for their
+// size where it exists. Camera and target calls nest like raylib's.
+
+struct Render_Backend {
+    const char *name;
+    bool headless; // No window, input or audio
+
+    Texture2D (*load_texture)(const char *path);
+    Texture2D (*load_texture_from_image)(Image image);
+    RenderTexture2D (*load_render_texture)(s32 width, s32 height);
+    void (*update_texture)(Texture2D texture, const void *pixels);
+
+    void (*begin_frame)(Color clear);
+    void (*end_frame)();
+    void (*begin_target)(RenderTexture2D *target, Color clear);
+    void (*end_target)();
+    void (*begin_camera)(Camera2D camera);
+    void (*end_camera)();
+
+    void (*draw_texture)(Texture2D texture, Rectangle src, Rectangle dest, Color color);
+    void (*draw_texture_quad)(Texture2D texture, Vector2 tiling, Vector2 offset, Rectangle quad, Color color);
+    void (*draw_line)(Vector2 start, Vector2 end, f32 thickness, Color color);
+    void (*draw_rect)(Rectangle rect, Color color);
+    void (*draw_text)(const char *text, s32 x, s32 y, s32 size, Color color);
+
+    // Copies the frame drawn so far, top row first. False when there are no
+    // pixels or the screen isn't width by height.
+    bool (*read_screen)(Color *pixels, s32 width, s32 height);
+};
+
+// raylib
+
+// From rlgl.h, which isn't shipped with the headers we use
+extern "C" void rlglDraw(void);
+
+static RenderTexture2D
+raylib_load_render_texture(s32 width, s32 height) {
+    return LoadRenderTexture(width, height);
+}
+
+static void
+raylib_begin_frame(Color clear) {
+    BeginDrawing();
+    ClearBackground(clear);
+}
+
+static void
+raylib_end_frame() {
+    EndDrawing();
+}
+
+static void
+raylib_begin_target(RenderTexture2D *target, Color clear) {
+    BeginTextureMode(*target);
+    ClearBackground(clear);
+}
+
+static void
+raylib_draw_texture(Texture2D texture, Rectangle src, Rectangle dest, Color color) {
+    DrawTexturePro(texture, src, dest, {0, 0}, 0.f, color);
+}
+
+static void
+raylib_draw_line(Vector2 start, Vector2 end, f32 thickness, Color color) {
+    DrawLineEx(start, end, thickness, color);
+}
+
+// GetScreenData allocates, the copy goes into the caller's buffer
+static bool
+raylib_read_screen(Color *pixels, s32 width, s32 height) {
+    // GetScreenData reads what's been drawn so far, the batch is only flushed
+    // on mode and target changes or in EndDrawing
+    rlglDraw();
+    Image image = GetScreenData();
+    bool ok = (image.data && image.width == width && image.height == height && image.format == UNCOMPRESSED_R8G8B8A8);
+    if(ok) {
+        memcpy(pixels, image.data, sizeof(Color)*width*height);
+    }
+    UnloadImage(image);
+    return ok;
+}
+
+static Render_Backend g_raylib_backend = {
+    "raylib", false,
+    LoadTexture, LoadTextureFromImage, raylib_load_render_texture, UpdateTexture,
+    raylib_begin_frame, raylib_end_frame, raylib_begin_target, EndTextureMode, BeginMode2D, EndMode2D,
+    raylib_draw_texture, DrawTextureQuad, raylib_draw_line, DrawRectangleRec, DrawText,
+    raylib_read_screen,
+};
+
+// null
+
+static u32 g_null_texture_id;
+
+static Texture2D
+null_load_texture(const char *path) {
+    Image image = LoadImage(path);
+    Texture2D result = {};
+    result.id = ++g_null_texture_id;
+    result.width = image.width;
+    result.height = image.height;
+    result.mipmaps = 1;
+    result.format = image.format;
+    UnloadImage(image);
+    return result;
+}
+
+static Texture2D
+null_load_texture_from_image(Image image) {
+    Texture2D result = {};
+    result.id = ++g_null_texture_id;
+    result.width = image.width;
+    result.height = image.height;
+    result.mipmaps = 1;
+    result.format = image.format;
+    return result;
+}
+
+static RenderTexture2D
+null_load_render_texture(s32 width, s32 height) {
+    RenderTexture2D result = {};
+    result.id = ++g_null_texture_id;
+    result.texture.id = ++g_null_texture_id;
+    result.texture.width = width;
+    result.texture.height = height;
+    result.texture.mipmaps = 1;
+    return result;
+}
+
+static void null_update_texture(Texture2D texture, const void *pixels) {}
+static void null_begin_frame(Color clear) {}
+static void null_end_frame() {}
+static void null_begin_target(RenderTexture2D *target, Color clear) {}
+static void null_end_target() {}
+static void null_begin_camera(Camera2D camera) {}
+static void null_end_camera() {}
+static void null_draw_texture(Texture2D texture, Rectangle src, Rectangle dest, Color color) {}
+static void null_draw_texture_quad(Texture2D texture, Vector2 tiling, Vector2 offset, Rectangle quad, Color color) {}
+static void null_draw_line(Vector2 start, Vector2 end, f32 thickness, Color color) {}
+static void null_draw_rect(Rectangle rect, Color color) {}
+static void null_draw_text(const char *text, s32 x, s32 y, s32 size, Color color) {}
+static bool null_read_screen(Color *pixels, s32 width, s32 height) { return false; }
+
+static Render_Backend g_null_backend = {
+    "null", true,
+    null_load_texture, null_load_texture_from_image, null_load_render_texture, null_update_texture,
+    null_begin_frame, null_end_frame, null_begin_target, null_end_target, null_begin_camera, null_end_camera,
+    null_draw_texture, null_draw_texture_quad, null_draw_line, null_draw_rect, null_draw_text,
+    null_read_screen,
+};
+
+// record
+
+struct Backend_Stats {
+    u32 draw_calls;
+    u32 texture_switches; // Draws using a different texture than the last, raylib's batch breaks
+    u32 vertices;
+    u32 target_switches;
+    u32 texture_updates;
+};
+
+struct Backend_Recording {
+    u32 last_texture;
+    u32 frame_count;
+    Backend_Stats frame; // Last complete frame
+    Backend_Stats current;
+    Backend_Stats total;
+};
+static Backend_Recording g_backend_recording;
+
+// Untextured shapes draw with raylib's white texture, id 0 here
+static void
+record_draw(u32 texture_id, u32 vertices) {
+    Backend_Stats *stats = &g_backend_recording.current;
+    stats->draw_calls += 1;
+    stats->vertices += vertices;
+    if(texture_id != g_backend_recording.last_texture) {
+        stats->texture_switches += 1;
+        g_backend_recording.last_texture = texture_id;
+    }
+}
+
+static void
+record_update_texture(Texture2D texture, const void *pixels) {
+    g_backend_recording.current.texture_updates += 1;
+}
+
+static void
+record_begin_frame(Color clear) {
+    g_backend_recording.current = {};
+    g_backend_recording.last_texture = UINT32_MAX;
+}
+
+static void
+record_end_frame() {
+    Backend_Recording *recording = &g_backend_recording;
+    recording->frame = recording->current;
+    recording->frame_count += 1;
+    recording->total.draw_calls += recording->current.draw_calls;
+    recording->total.texture_switches += recording->current.texture_switches;
+    recording->total.vertices += recording->current.vertices;
+    recording->total.target_switches += recording->current.target_switches;
+    recording->total.texture_updates += recording->current.texture_updates;
+}
+
+static void
+record_begin_target(RenderTexture2D *target, Color clear) {
+    g_backend_recording.current.target_switches += 1;
+    g_backend_recording.last_texture = UINT32_MAX; // Switching framebuffers flushes the batch
+}
+
+static void
+record_end_target() {
+    g_backend_recording.current.target_switches += 1;
+    g_backend_recording.last_texture = UINT32_MAX;
+}
+
+static void
+record_draw_texture(Texture2D texture, Rectangle src, Rectangle dest, Color color) {
+    record_draw(texture.id, 4);
+}
+
+// raylib's DrawTextureQuad is one quad however far it tiles
+static void
+record_draw_texture_quad(Texture2D texture, Vector2 tiling, Vector2 offset, Rectangle quad, Color color) {
+    record_draw(texture.id, 4);
+}
+
+static void
+record_draw_line(Vector2 start, Vector2 end, f32 thickness, Color color) {
+    record_draw(0, 4);
+}
+
+static void
+record_draw_rect(Rectangle rect, Color color) {
+    record_draw(0, 4);
+}
+
+// A quad per visible glyph from the default font
+static void
+record_draw_text(const char *text, s32 x, s32 y, s32 size, Color color) {
+    u32 glyphs = 0;
+    for(const char *c = text; *c; c++) {
+        if(*c != ' ' && *c != '\n') glyphs += 1;
+    }
+    record_draw(GetFontDefault().texture.id, glyphs * 4);
+}
+
+static Render_Backend g_record_backend = {
+    "record", true,
+    null_load_texture, null_load_texture_from_image, null_load_render_texture, record_update_texture,
+    record_begin_frame, record_end_frame, record_begin_target, record_end_target, null_begin_camera, null_end_camera,
+    record_draw_texture, record_draw_texture_quad, record_draw_line, record_draw_rect, record_draw_text,
+    null_read_screen,
+};
+
+static Render_Backend *g_backend = &g_raylib_backend;
+
+static void
+print_backend_recording() {
+    Backend_Recording *recording = &g_backend_recording;
+    f64 frames = (recording->frame_count > 0) ? (f64)recording->frame_count : 1.0;
+    printf("record: %u frames, per frame %.1f draw calls %.1f texture switches %.1f vertices %.1f target switches %.1f texture updates\n",
+           recording->frame_count, recording->total.draw_calls / frames, recording->total.texture_switches / frames,
+           recording->total.vertices / frames, recording->total.target_switches / frames,
+           recording->total.texture_updates / frames);
+}
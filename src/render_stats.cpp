@@ -0,0 +1,105 @@
+
+// Render stats panel (F5) and per frame export (-render_stats <path>). Both
+// show the Render_Stats of the last list submitted: draw calls, texture
+// binds, sprites, passes, uploads, time sorting, executing and presenting,
+// the world resolution and items per layer, which is where draw_entities,
+// the projectiles and the HUD each push. The export is CSV, or JSON when the
+// path ends in .json, a row or object per frame.
+
+static const char *RENDER_LAYER_NAMES[RENDER_LAYER_COUNT] = {
+    "offscreen", "background", "ground", "props", "actors", "player", "projectiles", "particles",
+    "dialog", "hud", "debug", "cursor",
+};
+
+struct Render_Stats_Export {
+    FILE *file;
+    bool json;
+    u32 frame_count;
+};
+static Render_Stats_Export g_render_stats_export;
+
+static bool
+open_render_stats_export(Render_Stats_Export *export_file, const char *path) {
+    export_file->file = fopen(path, "w");
+    if(!export_file->file) return false;
+
+    u32 length = (u32)strlen(path);
+    export_file->json = (length >= 5 && strcmp(path + length - 5, ".json") == 0);
+    export_file->frame_count = 0;
+
+    if(export_file->json) {
+        fprintf(export_file->file, "[\n");
+    } else {
+        fprintf(export_file->file, "frame,frame_ms,items,batches,draw_calls,sprites,target_switches,texture_updates,sort_ms,execute_ms,present_ms,world_resolution");
+        for(u32 layer = 0; layer < RENDER_LAYER_COUNT; layer++) {
+            fprintf(export_file->file, ",%s", RENDER_LAYER_NAMES[layer]);
+        }
+        fprintf(export_file->file, "\n");
+    }
+    return true;
+}
+
+static void
+write_render_stats(Render_Stats_Export *export_file, Render_Stats *stats, f32 frame_ms) {
+    if(!export_file->file) return;
+
+    FILE *file = export_file->file;
+    if(export_file->json) {
+        fprintf(file, "%s{\"frame\":%u,\"frame_ms\":%.3f,\"items\":%u,\"batches\":%u,\"draw_calls\":%u,\"sprites\":%u,"
+                "\"target_switches\":%u,\"texture_updates\":%u,\"sort_ms\":%.3f,\"execute_ms\":%.3f,\"present_ms\":%.3f,\"world_resolution\":%.3f,\"layers\":{",
+                (export_file->frame_count > 0) ? ",\n" : "", export_file->frame_count, frame_ms, stats->items, stats->batches,
+                stats->draw_calls, stats->sprites, stats->target_switches, stats->texture_updates,
+                stats->sort_ms, stats->execute_ms, stats->present_ms, stats->world_resolution);
+        for(u32 layer = 0; layer < RENDER_LAYER_COUNT; layer++) {
+            fprintf(file, "%s\"%s\":%u", layer ? "," : "", RENDER_LAYER_NAMES[layer], stats->layer_items[layer]);
+        }
+        fprintf(file, "}}");
+    } else {
+        fprintf(file, "%u,%.3f,%u,%u,%u,%u,%u,%u,%.3f,%.3f,%.3f,%.3f", export_file->frame_count, frame_ms, stats->items, stats->batches,
+                stats->draw_calls, stats->sprites, stats->target_switches, stats->texture_updates,
+                stats->sort_ms, stats->execute_ms, stats->present_ms, stats->world_resolution);
+        for(u32 layer = 0; layer < RENDER_LAYER_COUNT; layer++) {
+            fprintf(file, ",%u", stats->layer_items[layer]);
+        }
+        fprintf(file, "\n");
+    }
+    export_file->frame_count += 1;
+}
+
+static void
+close_render_stats_export(Render_Stats_Export *export_file) {
+    if(!export_file->file) return;
+    if(export_file->json) {
+        fprintf(export_file->file, "\n]\n");
+    }
+    fclose(export_file->file);
+    export_file->file = nullptr;
+}
+
+static void
+draw_render_stats_overlay(Render_List *render) {
+    if(!g_debug.render_stats) return;
+
+    char buf[128];
+    s32 x = 20;
+    s32 y = 70;
+
+    push_rect(render, RENDER_LAYER_DEBUG, 0, {(f32)x - 10, (f32)y - 10, 300, 112 + RENDER_LAYER_COUNT * 20}, {0,0,0,160});
+
+    snprintf(buf, sizeof(buf), "draw calls: %u  binds: %u", g_render_stats.draw_calls, g_render_stats.batches);
+    push_text(render, RENDER_LAYER_DEBUG, 1, buf, x, y, 20, WHITE); y += 24;
+
+    snprintf(buf, sizeof(buf), "sprites: %u  items: %u", g_render_stats.sprites, g_render_stats.items);
+    push_text(render, RENDER_LAYER_DEBUG, 1, buf, x, y, 20, WHITE); y += 24;
+
+    snprintf(buf, sizeof(buf), "targets: %u  uploads: %u", g_render_stats.target_switches, g_render_stats.texture_updates);
+    push_text(render, RENDER_LAYER_DEBUG, 1, buf, x, y, 20, WHITE); y += 24;
+
+    snprintf(buf, sizeof(buf), "sort %.2f exec %.2f present %.2f", g_render_stats.sort_ms, g_render_stats.execute_ms, g_render_stats.present_ms);
+    push_text(render, RENDER_LAYER_DEBUG, 1, buf, x, y, 20, WHITE); y += 24;
+
+    for(u32 layer = 0; layer < RENDER_LAYER_COUNT; layer++) {
+        snprintf(buf, sizeof(buf), "  %s: %u", RENDER_LAYER_NAMES[layer], g_render_stats.layer_items[layer]);
+        push_text(render, RENDER_LAYER_DEBUG, 1, buf, x, y, 16, LIGHTGRAY); y += 20;
+    }
+}
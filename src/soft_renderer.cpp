@@ -0,0 +1,572 @@
+
+// Software renderer backend (-renderer soft) for headless runs that need
+// pixels. Textures are kept as RGBA8 in the arena and the screen is a memory
+// framebuffer. Draws are transformed to target pixels as they come in and
+// queued; at a target switch or the end of the frame the queue is rasterized
+// in bands of SOFT_BAND_HEIGHT rows, which the calling thread and
+// SOFT_THREAD_COUNT - 1 workers take from a shared counter. Every band runs
+// the whole queue in order, so overlapping draws blend as they would on the
+// GPU.
+//
+// Sampling is nearest neighbour and blending is the usual alpha over, four
+// pixels at a time with SSE2. raylib's default font only exists with a GL
+// context, so text is drawn as a box per glyph. Render textures are stored
+// bottom up like GL's, so draws that flip them with a negative source height
+// come out the right way up.
+//
+// Each frame prints a checksum of the framebuffer, and with -dump_frames the
+// frame is also written out as a PNG.
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SOFT_SSE 1
+#endif
+
+static constexpr u32 MAX_SOFT_TEXTURES = 64;
+static constexpr u32 MAX_SOFT_COMMANDS = 64*1024;
+static constexpr u32 SOFT_THREAD_COUNT = 4;
+static constexpr s32 SOFT_BAND_HEIGHT = 16;
+
+struct Soft_Texture {
+    s32 width;
+    s32 height;
+    bool bottom_up;
+    Color *pixels;
+};
+
+enum {
+    SOFT_TEXTURE,
+    SOFT_TEXTURE_TILED,
+    SOFT_LINE,
+    SOFT_RECT,
+};
+
+// Positions are in target pixels
+struct Soft_Command {
+    u8 type;
+    u32 texture;
+    Rectangle src;  // Tiled: tiling in x, y and offset in width, height. Line: start in x, y and end in width, height.
+    Rectangle dest;
+    f32 thickness;
+    Color color;
+};
+
+struct Soft_Renderer {
+    Allocator *allocator;
+    u32 texture_count;
+    Soft_Texture textures[MAX_SOFT_TEXTURES]; // By texture id
+    Soft_Texture screen;
+    Soft_Texture *target;
+
+    bool in_camera;
+    Camera2D camera;
+
+    u32 command_count;
+    Soft_Command *commands;
+
+    Sys_Thread threads[SOFT_THREAD_COUNT - 1];
+    Sys_Semaphore start;
+    Sys_Semaphore done;
+    volatile u32 next_band;
+    bool quit;
+
+    u32 frame_count;
+    const char *dump_dir; // nullptr for checksums only
+};
+static Soft_Renderer g_soft;
+
+// Texture ids index the table, 0 is never handed out
+static u32
+add_soft_texture(s32 width, s32 height, bool bottom_up) {
+    Soft_Renderer *soft = &g_soft;
+    if(soft->texture_count + 1 >= MAX_SOFT_TEXTURES) return 0;
+
+    u32 id = ++soft->texture_count;
+    Soft_Texture *texture = &soft->textures[id];
+    texture->width = width;
+    texture->height = height;
+    texture->bottom_up = bottom_up;
+    texture->pixels = nullptr;
+    if(width > 0 && height > 0) {
+        texture->pixels = (Color*)alloc_raw(soft->allocator, sizeof(Color)*width*height, 16);
+        memset(texture->pixels, 0, sizeof(Color)*width*height);
+    }
+    return id;
+}
+
+static Texture2D
+soft_load_texture_from_image(Image image) {
+    Image copy = ImageCopy(image);
+    ImageFormat(&copy, UNCOMPRESSED_R8G8B8A8);
+
+    Texture2D result = {};
+    result.id = add_soft_texture(copy.width, copy.height, false);
+    result.width = copy.width;
+    result.height = copy.height;
+    result.mipmaps = 1;
+    result.format = UNCOMPRESSED_R8G8B8A8;
+    if(result.id && copy.data) {
+        memcpy(g_soft.textures[result.id].pixels, copy.data, sizeof(Color)*copy.width*copy.height);
+    }
+    UnloadImage(copy);
+    return result;
+}
+
+// A missing file gives an empty texture, draws from it are skipped
+static Texture2D
+soft_load_texture(const char *path) {
+    Image image = LoadImage(path);
+    Texture2D result = soft_load_texture_from_image(image);
+    UnloadImage(image);
+    return result;
+}
+
+static RenderTexture2D
+soft_load_render_texture(s32 width, s32 height) {
+    RenderTexture2D result = {};
+    result.texture.id = add_soft_texture(width, height, true);
+    result.texture.width = width;
+    result.texture.height = height;
+    result.texture.mipmaps = 1;
+    result.texture.format = UNCOMPRESSED_R8G8B8A8;
+    result.id = result.texture.id;
+    return result;
+}
+
+inline static Color
+modulate(Color a, Color b) {
+    return {(u8)((a.r * b.r + 255) >> 8), (u8)((a.g * b.g + 255) >> 8), (u8)((a.b * b.b + 255) >> 8), (u8)((a.a * b.a + 255) >> 8)};
+}
+
+inline static bool
+is_white(Color c) {
+    return (c.r & c.g & c.b & c.a) == 255;
+}
+
+#ifdef SOFT_SSE
+// Alpha over for four pixels: rgb = src*a + dst*(1 - a), alpha = a + dst*(1 - a)
+inline static __m128i
+blend_soft_pixels(__m128i src, __m128i dst) {
+    __m128i zero = _mm_setzero_si128();
+    __m128i alpha_lanes = _mm_set_epi16(255, 0, 0, 0, 255, 0, 0, 0);
+    __m128i round = _mm_set1_epi16(128);
+    __m128i full = _mm_set1_epi16(255);
+
+    __m128i result[2];
+    for(u32 half = 0; half < 2; half++) {
+        __m128i s = half ? _mm_unpackhi_epi8(src, zero) : _mm_unpacklo_epi8(src, zero);
+        __m128i d = half ? _mm_unpackhi_epi8(dst, zero) : _mm_unpacklo_epi8(dst, zero);
+        __m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s, _MM_SHUFFLE(3,3,3,3)), _MM_SHUFFLE(3,3,3,3));
+        s = _mm_or_si128(s, alpha_lanes);
+
+        // (s*a + d*(255 - a)) / 255, fits in unsigned 16 bits
+        __m128i sum = _mm_add_epi16(_mm_mullo_epi16(s, a), _mm_mullo_epi16(d, _mm_sub_epi16(full, a)));
+        sum = _mm_add_epi16(sum, round);
+        result[half] = _mm_srli_epi16(_mm_add_epi16(sum, _mm_srli_epi16(sum, 8)), 8);
+    }
+    return _mm_packus_epi16(result[0], result[1]);
+}
+#endif
+
+// Same rounding as the four pixel version
+inline static u8
+blend_soft_channel(u32 src, u32 dst, u32 alpha) {
+    u32 sum = src*alpha + dst*(255 - alpha) + 128;
+    return (u8)((sum + (sum >> 8)) >> 8);
+}
+
+inline static void
+blend_soft_pixel(Color *dst, Color src) {
+    if(src.a == 255) {
+        *dst = src;
+    } else if(src.a > 0) {
+        dst->r = blend_soft_channel(src.r, dst->r, src.a);
+        dst->g = blend_soft_channel(src.g, dst->g, src.a);
+        dst->b = blend_soft_channel(src.b, dst->b, src.a);
+        dst->a = blend_soft_channel(255, dst->a, src.a);
+    }
+}
+
+// Pixels whose centers are inside [v0, v1), clipped to [min, max)
+inline static void
+get_soft_span(f32 v0, f32 v1, s32 min, s32 max, s32 *first, s32 *end) {
+    *first = (s32)ceilf(v0 - 0.5f);
+    *end = (s32)ceilf(v1 - 0.5f);
+    if(*first < min) *first = min;
+    if(*end > max) *end = max;
+}
+
+static void
+rasterize_soft_texture(Soft_Texture *target, Soft_Command *command, s32 band_y0, s32 band_y1) {
+    Soft_Texture *texture = &g_soft.textures[command->texture];
+    if(!texture->pixels) return;
+
+    Rectangle dest = command->dest;
+    Rectangle src = command->src;
+    bool tiled = (command->type == SOFT_TEXTURE_TILED);
+    if(tiled) {
+        // Tiling and offset in texture sizes, wrapping
+        src = {command->src.width * texture->width, command->src.height * texture->height,
+               command->src.x * texture->width, command->src.y * texture->height};
+    }
+    if(dest.width <= 0.f || dest.height <= 0.f) return;
+
+    s32 x0, x1, y0, y1;
+    get_soft_span(dest.x, dest.x + dest.width, 0, target->width, &x0, &x1);
+    get_soft_span(dest.y, dest.y + dest.height, band_y0, band_y1, &y0, &y1);
+    if(x0 >= x1 || y0 >= y1) return;
+
+    // Negative source sizes flip, like raylib
+    f32 u_origin = (src.width < 0.f) ? src.x - src.width : src.x;
+    f32 v_origin = (src.height < 0.f) ? src.y - src.height : src.y;
+    f32 u_step = src.width / dest.width;
+    f32 v_step = src.height / dest.height;
+    bool tint = !is_white(command->color);
+
+    Color texels[4];
+    for(s32 y = y0; y < y1; y++) {
+        s32 v = (s32)floorf(v_origin + (y + 0.5f - dest.y) * v_step);
+        if(tiled) {
+            v %= texture->height;
+            if(v < 0) v += texture->height;
+        } else if(v < 0 || v >= texture->height) {
+            continue;
+        }
+        if(texture->bottom_up) v = texture->height - 1 - v;
+
+        Color *row = target->pixels + y*target->width;
+        Color *texture_row = texture->pixels + v*texture->width;
+        f32 u = u_origin + (x0 + 0.5f - dest.x) * u_step;
+        s32 x = x0;
+        while(x < x1) {
+            u32 count = (x1 - x < 4) ? (u32)(x1 - x) : 4;
+            for(u32 i = 0; i < count; i++, u += u_step) {
+                s32 tu = (s32)floorf(u);
+                if(tiled) {
+                    tu %= texture->width;
+                    if(tu < 0) tu += texture->width;
+                } else {
+                    tu = (tu < 0) ? 0 : (tu >= texture->width) ? texture->width - 1 : tu;
+                }
+                texels[i] = tint ? modulate(texture_row[tu], command->color) : texture_row[tu];
+            }
+
+#ifdef SOFT_SSE
+            if(count == 4) {
+                __m128i src_pixels = _mm_loadu_si128((__m128i*)texels);
+                __m128i dst_pixels = _mm_loadu_si128((__m128i*)(row + x));
+                _mm_storeu_si128((__m128i*)(row + x), blend_soft_pixels(src_pixels, dst_pixels));
+                x += count;
+                continue;
+            }
+#endif
+            for(u32 i = 0; i < count; i++) {
+                blend_soft_pixel(row + x + i, texels[i]);
+            }
+            x += count;
+        }
+    }
+}
+
+static void
+rasterize_soft_rect(Soft_Texture *target, Soft_Command *command, s32 band_y0, s32 band_y1) {
+    Rectangle dest = command->dest;
+    s32 x0, x1, y0, y1;
+    get_soft_span(dest.x, dest.x + dest.width, 0, target->width, &x0, &x1);
+    get_soft_span(dest.y, dest.y + dest.height, band_y0, band_y1, &y0, &y1);
+
+    Color color = command->color;
+#ifdef SOFT_SSE
+    __m128i src_pixels = _mm_set1_epi32(*(s32*)&color);
+#endif
+    for(s32 y = y0; y < y1; y++) {
+        Color *row = target->pixels + y*target->width;
+        s32 x = x0;
+#ifdef SOFT_SSE
+        for(; x + 4 <= x1; x += 4) {
+            __m128i dst_pixels = _mm_loadu_si128((__m128i*)(row + x));
+            _mm_storeu_si128((__m128i*)(row + x), blend_soft_pixels(src_pixels, dst_pixels));
+        }
+#endif
+        for(; x < x1; x++) {
+            blend_soft_pixel(row + x, color);
+        }
+    }
+}
+
+// Pixels whose centers are within half the thickness of the segment
+static void
+rasterize_soft_line(Soft_Texture *target, Soft_Command *command, s32 band_y0, s32 band_y1) {
+    Vector2 a = {command->src.x, command->src.y};
+    Vector2 b = {command->src.width, command->src.height};
+    f32 radius = command->thickness * 0.5f;
+    f32 min_x = fminf(a.x, b.x) - radius, max_x = fmaxf(a.x, b.x) + radius;
+    f32 min_y = fminf(a.y, b.y) - radius, max_y = fmaxf(a.y, b.y) + radius;
+
+    s32 x0, x1, y0, y1;
+    get_soft_span(min_x, max_x, 0, target->width, &x0, &x1);
+    get_soft_span(min_y, max_y, band_y0, band_y1, &y0, &y1);
+
+    Vector2 ab = sub_vec2(b, a);
+    f32 length_sq = ab.x*ab.x + ab.y*ab.y;
+    for(s32 y = y0; y < y1; y++) {
+        for(s32 x = x0; x < x1; x++) {
+            Vector2 ap = {x + 0.5f - a.x, y + 0.5f - a.y};
+            f32 t = (length_sq > 0.f) ? (ap.x*ab.x + ap.y*ab.y) / length_sq : 0.f;
+            t = (t < 0.f) ? 0.f : (t > 1.f) ? 1.f : t;
+            f32 dx = ap.x - ab.x*t;
+            f32 dy = ap.y - ab.y*t;
+            if(dx*dx + dy*dy <= radius*radius) {
+                blend_soft_pixel(target->pixels + y*target->width + x, command->color);
+            }
+        }
+    }
+}
+
+static void
+rasterize_soft_bands(Soft_Renderer *soft) {
+    Soft_Texture *target = soft->target;
+    s32 band_count = (target->height + SOFT_BAND_HEIGHT - 1) / SOFT_BAND_HEIGHT;
+    for(;;) {
+        s32 band = (s32)sys_atomic_increment(&soft->next_band);
+        if(band >= band_count) break;
+
+        s32 y0 = band * SOFT_BAND_HEIGHT;
+        s32 y1 = (y0 + SOFT_BAND_HEIGHT < target->height) ? y0 + SOFT_BAND_HEIGHT : target->height;
+        for(u32 idx = 0; idx < soft->command_count; idx++) {
+            Soft_Command *command = &soft->commands[idx];
+            switch(command->type) {
+                case SOFT_TEXTURE:
+                case SOFT_TEXTURE_TILED: rasterize_soft_texture(target, command, y0, y1); break;
+                case SOFT_LINE: rasterize_soft_line(target, command, y0, y1); break;
+                case SOFT_RECT: rasterize_soft_rect(target, command, y0, y1); break;
+            }
+        }
+    }
+}
+
+static void
+soft_thread_proc(void *data) {
+    Soft_Renderer *soft = (Soft_Renderer*)data;
+    for(;;) {
+        sys_wait_semaphore(&soft->start);
+        if(soft->quit) break;
+        rasterize_soft_bands(soft);
+        sys_signal_semaphore(&soft->done);
+    }
+}
+
+// Rasterizes and empties the queue
+static void
+flush_soft_commands(Soft_Renderer *soft) {
+    if(soft->command_count == 0 || !soft->target->pixels) {
+        soft->command_count = 0;
+        return;
+    }
+
+    soft->next_band = 0;
+    for(u32 i = 0; i < SOFT_THREAD_COUNT - 1; i++) sys_signal_semaphore(&soft->start);
+    rasterize_soft_bands(soft);
+    for(u32 i = 0; i < SOFT_THREAD_COUNT - 1; i++) sys_wait_semaphore(&soft->done);
+
+    soft->command_count = 0;
+}
+
+// Needs the arena for texture memory, call before loading anything
+static void
+init_soft_renderer(Soft_Renderer *soft, Allocator *allocator, s32 width, s32 height) {
+    soft->allocator = allocator;
+    soft->texture_count = 0;
+    soft->screen.width = width;
+    soft->screen.height = height;
+    soft->screen.pixels = (Color*)alloc_raw(allocator, sizeof(Color)*width*height, 16);
+    soft->target = &soft->screen;
+    soft->commands = alloc_array(allocator, Soft_Command, MAX_SOFT_COMMANDS);
+
+    sys_init_semaphore(&soft->start, 0);
+    sys_init_semaphore(&soft->done, 0);
+    for(u32 i = 0; i < SOFT_THREAD_COUNT - 1; i++) {
+        sys_create_thread(&soft->threads[i], soft_thread_proc, soft);
+    }
+}
+
+static void
+shutdown_soft_renderer(Soft_Renderer *soft) {
+    soft->quit = true;
+    for(u32 i = 0; i < SOFT_THREAD_COUNT - 1; i++) sys_signal_semaphore(&soft->start);
+    for(u32 i = 0; i < SOFT_THREAD_COUNT - 1; i++) sys_join_thread(&soft->threads[i]);
+    sys_destroy_semaphore(&soft->start);
+    sys_destroy_semaphore(&soft->done);
+}
+
+static void
+clear_soft_texture(Soft_Texture *texture, Color color) {
+    if(!texture->pixels) return;
+    for(s32 i = 0; i < texture->width*texture->height; i++) {
+        texture->pixels[i] = color;
+    }
+}
+
+inline static Vector2
+to_soft_pixels(Vector2 pos) {
+    Soft_Renderer *soft = &g_soft;
+    if(!soft->in_camera) return pos;
+    return {(pos.x - soft->camera.target.x) * soft->camera.zoom + soft->camera.offset.x,
+            (pos.y - soft->camera.target.y) * soft->camera.zoom + soft->camera.offset.y};
+}
+
+inline static Rectangle
+to_soft_rect(Rectangle rect) {
+    Vector2 pos = to_soft_pixels({rect.x, rect.y});
+    f32 zoom = g_soft.in_camera ? g_soft.camera.zoom : 1.f;
+    return {pos.x, pos.y, rect.width * zoom, rect.height * zoom};
+}
+
+static Soft_Command*
+push_soft_command(u8 type) {
+    Soft_Renderer *soft = &g_soft;
+    if(soft->command_count == MAX_SOFT_COMMANDS) {
+        flush_soft_commands(soft);
+    }
+    Soft_Command *command = &soft->commands[soft->command_count++];
+    command->type = type;
+    return command;
+}
+
+static void
+soft_update_texture(Texture2D texture, const void *pixels) {
+    flush_soft_commands(&g_soft); // Queued draws may use the old pixels
+    Soft_Texture *soft_texture = &g_soft.textures[texture.id];
+    if(soft_texture->pixels) {
+        memcpy(soft_texture->pixels, pixels, sizeof(Color)*soft_texture->width*soft_texture->height);
+    }
+}
+
+static void
+soft_begin_frame(Color clear) {
+    g_soft.target = &g_soft.screen;
+    clear_soft_texture(&g_soft.screen, clear);
+}
+
+static u32
+get_soft_checksum(Soft_Texture *texture) {
+    // FNV-1a
+    u32 hash = 2166136261u;
+    u8 *bytes = (u8*)texture->pixels;
+    for(s32 i = 0; i < texture->width*texture->height*4; i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static void
+soft_end_frame() {
+    Soft_Renderer *soft = &g_soft;
+    flush_soft_commands(soft);
+    printf("soft: frame %u checksum %08x\n", soft->frame_count, get_soft_checksum(&soft->screen));
+
+    if(soft->dump_dir) {
+        char path[512];
+        snprintf(path, sizeof(path), "%s/frame_%05u.png", soft->dump_dir, soft->frame_count);
+        Image image = {soft->screen.pixels, soft->screen.width, soft->screen.height, 1, UNCOMPRESSED_R8G8B8A8};
+        if(!ExportImage(image, path)) {
+            printf("Failed to write %s\n", path);
+        }
+    }
+    soft->frame_count += 1;
+}
+
+static void
+soft_begin_target(RenderTexture2D *target, Color clear) {
+    flush_soft_commands(&g_soft);
+    g_soft.target = &g_soft.textures[target->texture.id];
+    clear_soft_texture(g_soft.target, clear);
+}
+
+static void
+soft_end_target() {
+    flush_soft_commands(&g_soft);
+    g_soft.target = &g_soft.screen;
+}
+
+static void
+soft_begin_camera(Camera2D camera) {
+    g_soft.in_camera = true;
+    g_soft.camera = camera;
+}
+
+static void
+soft_end_camera() {
+    g_soft.in_camera = false;
+}
+
+static void
+soft_draw_texture(Texture2D texture, Rectangle src, Rectangle dest, Color color) {
+    Soft_Command *command = push_soft_command(SOFT_TEXTURE);
+    command->texture = texture.id;
+    command->src = src;
+    command->dest = to_soft_rect(dest);
+    command->color = color;
+}
+
+static void
+soft_draw_texture_quad(Texture2D texture, Vector2 tiling, Vector2 offset, Rectangle quad, Color color) {
+    Soft_Command *command = push_soft_command(SOFT_TEXTURE_TILED);
+    command->texture = texture.id;
+    command->src = {tiling.x, tiling.y, offset.x, offset.y};
+    command->dest = to_soft_rect(quad);
+    command->color = color;
+}
+
+static void
+soft_draw_line(Vector2 start, Vector2 end, f32 thickness, Color color) {
+    Vector2 a = to_soft_pixels(start);
+    Vector2 b = to_soft_pixels(end);
+    Soft_Command *command = push_soft_command(SOFT_LINE);
+    command->src = {a.x, a.y, b.x, b.y};
+    command->thickness = thickness * (g_soft.in_camera ? g_soft.camera.zoom : 1.f);
+    command->color = color;
+}
+
+static void
+soft_draw_rect(Rectangle rect, Color color) {
+    Soft_Command *command = push_soft_command(SOFT_RECT);
+    command->dest = to_soft_rect(rect);
+    command->color = color;
+}
+
+// A box per glyph, roughly where raylib's default font would put it
+static void
+soft_draw_text(const char *text, s32 x, s32 y, s32 size, Color color) {
+    f32 advance = size * 0.6f;
+    f32 pen_x = (f32)x;
+    f32 pen_y = (f32)y;
+    for(const char *c = text; *c; c++) {
+        if(*c == '\n') {
+            pen_x = (f32)x;
+            pen_y += size * 1.5f;
+            continue;
+        }
+        if(*c != ' ') {
+            soft_draw_rect({pen_x, pen_y + size * 0.2f, size * 0.45f, size * 0.7f}, color);
+        }
+        pen_x += advance;
+    }
+}
+
+static bool
+soft_read_screen(Color *pixels, s32 width, s32 height) {
+    Soft_Renderer *soft = &g_soft;
+    if(width != soft->screen.width || height != soft->screen.height) return false;
+    flush_soft_commands(soft);
+    memcpy(pixels, soft->screen.pixels, sizeof(Color)*width*height);
+    return true;
+}
+
+static Render_Backend g_soft_backend = {
+    "soft", true,
+    soft_load_texture, soft_load_texture_from_image, soft_load_render_texture, soft_update_texture,
+    soft_begin_frame, soft_end_frame, soft_begin_target, soft_end_target, soft_begin_camera, soft_end_camera,
+    soft_draw_texture, soft_draw_texture_quad, soft_draw_line, soft_draw_rect, soft_draw_text,
+    soft_read_screen,
+};
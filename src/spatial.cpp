@@ -0,0 +1,89 @@
+
+// Uniform grid over entity bounds, hashed into a fixed bucket table and built
+// with a counting sort, so a rebuild is two linear passes and a query only
+// visits the buckets of the cells it overlaps. Entities larger than a cell are
+// listed in every cell they cover. Hash collisions mean a bucket can hold
+// entities from other cells, so callers always test the actual bounds.
+
+static constexpr f32 GRID_CELL_SIZE = 64.f;
+static constexpr u32 GRID_BUCKET_COUNT = 16*1024;
+static constexpr u32 MAX_GRID_ENTRIES = 256*1024;
+
+struct Spatial_Grid {
+    u32 entity_count;
+    u32 entry_count;
+    u32 bucket_start[GRID_BUCKET_COUNT + 1];
+    u32 entries[MAX_GRID_ENTRIES]; // Entity indices
+};
+static Spatial_Grid *g_grid;
+
+inline static s32
+get_grid_coord(f32 v) {
+    return (s32)floorf(v / GRID_CELL_SIZE);
+}
+
+inline static u32
+get_grid_bucket(s32 cx, s32 cy) {
+    return ((u32)cx * 73856093u ^ (u32)cy * 19349663u) & (GRID_BUCKET_COUNT - 1);
+}
+
+static void
+build_spatial_grid(Spatial_Grid *grid, Entity_List *entity_list) {
+    memset(grid->bucket_start, 0, sizeof(grid->bucket_start));
+
+    // Count, leaving bucket_start[b + 1] holding the size of bucket b
+    u32 total = 0;
+    for(s32 entity_index = 0; entity_index < entity_list->entity_count; entity_index++) {
+        Rectangle bounds = get_bounds(&entity_list->entities[entity_index]);
+        s32 cx0 = get_grid_coord(bounds.x), cx1 = get_grid_coord(bounds.x + bounds.width);
+        s32 cy0 = get_grid_coord(bounds.y), cy1 = get_grid_coord(bounds.y + bounds.height);
+
+        u32 cells = (u32)(cx1 - cx0 + 1) * (u32)(cy1 - cy0 + 1);
+        if(total + cells > MAX_GRID_ENTRIES) break;
+        total += cells;
+
+        for(s32 cy = cy0; cy <= cy1; cy++) {
+            for(s32 cx = cx0; cx <= cx1; cx++) {
+                grid->bucket_start[get_grid_bucket(cx, cy) + 1] += 1;
+            }
+        }
+    }
+
+    for(u32 bucket = 0; bucket < GRID_BUCKET_COUNT; bucket++) {
+        grid->bucket_start[bucket + 1] += grid->bucket_start[bucket];
+    }
+
+    // Fill, bumping bucket_start[b] to the end of bucket b, then shift back
+    total = 0;
+    for(s32 entity_index = 0; entity_index < entity_list->entity_count; entity_index++) {
+        Rectangle bounds = get_bounds(&entity_list->entities[entity_index]);
+        s32 cx0 = get_grid_coord(bounds.x), cx1 = get_grid_coord(bounds.x + bounds.width);
+        s32 cy0 = get_grid_coord(bounds.y), cy1 = get_grid_coord(bounds.y + bounds.height);
+
+        u32 cells = (u32)(cx1 - cx0 + 1) * (u32)(cy1 - cy0 + 1);
+        if(total + cells > MAX_GRID_ENTRIES) break;
+        total += cells;
+
+        for(s32 cy = cy0; cy <= cy1; cy++) {
+            for(s32 cx = cx0; cx <= cx1; cx++) {
+                grid->entries[grid->bucket_start[get_grid_bucket(cx, cy)]++] = entity_index;
+            }
+        }
+    }
+
+    for(u32 bucket = GRID_BUCKET_COUNT; bucket > 0; bucket--) {
+        grid->bucket_start[bucket] = grid->bucket_start[bucket - 1];
+    }
+    grid->bucket_start[0] = 0;
+
+    grid->entry_count = total;
+    grid->entity_count = entity_list->entity_count;
+}
+
+// Entity indices listed in the bucket of cell (cx, cy)
+inline static u32
+get_grid_cell(Spatial_Grid *grid, s32 cx, s32 cy, u32 **entries) {
+    u32 bucket = get_grid_bucket(cx, cy);
+    *entries = grid->entries + grid->bucket_start[bucket];
+    return grid->bucket_start[bucket + 1] - grid->bucket_start[bucket];
+}
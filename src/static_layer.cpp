@@ -0,0 +1,186 @@
+
+// Static layer cache. Ground and props that aren't animating don't change once
+// a zone is built, so they're drawn into render textures covering
+// STATIC_TILE_SIZE world units each and a frame pushes the few tiles around
+// the view instead of every static entity. Tiles are rendered the first time
+// they come into view and reused least recently used first.
+//
+// Entity::static_cached says whether an entity is in the tiles. It's set for
+// ground when it's added and otherwise by anim_changed_proc whenever a sprite
+// changes sequence or frame. An entity moving in or out of the cache, like a
+// door starting to open or a corpse settling on its last frame, invalidates
+// the tiles under it. A zone load invalidates every tile.
+//
+// The background is already one screen space quad and isn't cached.
+
+static constexpr u32 STATIC_TILE_COUNT = 8; // The view overlaps at most 4
+static constexpr f32 STATIC_TILE_SIZE = 512.f;
+static constexpr u32 MAX_STATIC_TILE_ENTITIES = 4096;
+
+struct Static_Tile {
+    bool valid;
+    s32 x, y; // World position over STATIC_TILE_SIZE
+    u32 last_used;
+    RenderTexture2D target;
+};
+
+struct Static_Cache {
+    bool enabled;
+    u32 frame;
+    Static_Tile tiles[STATIC_TILE_COUNT];
+    u32 keys[MAX_STATIC_TILE_ENTITIES]; // Render layer and entity index of a tile's entities
+};
+static Static_Cache g_static_cache;
+
+struct Static_Cache_Stats {
+    u32 tiles;
+    u32 redraws; // Since start
+    u32 entities; // Drawn into tiles this frame
+    f32 draw_ms;
+};
+static Static_Cache_Stats g_static_cache_stats;
+
+// Needs the window
+static void
+init_static_cache(Static_Cache *cache) {
+    cache->enabled = true;
+    cache->frame = 0;
+    for(u32 i = 0; i < STATIC_TILE_COUNT; i++) {
+        Static_Tile *tile = &cache->tiles[i];
+        tile->valid = false;
+        tile->x = INT32_MIN;
+        tile->y = INT32_MIN;
+        tile->last_used = 0;
+        tile->target = g_backend->load_render_texture((s32)STATIC_TILE_SIZE, (s32)STATIC_TILE_SIZE);
+    }
+}
+
+inline static Rectangle
+get_static_tile_rec(Static_Tile *tile) {
+    return {tile->x * STATIC_TILE_SIZE, tile->y * STATIC_TILE_SIZE, STATIC_TILE_SIZE, STATIC_TILE_SIZE};
+}
+
+// Called on zone load
+static void
+mark_static_cache_dirty() {
+    for(u32 i = 0; i < STATIC_TILE_COUNT; i++) {
+        g_static_cache.tiles[i].valid = false;
+    }
+}
+
+// Called when an entity goes in or out of the cache
+static void
+mark_static_entity_dirty(Entity *entity) {
+    Rectangle area = {entity->pos.x, entity->pos.y, DRAW_CULL_MARGIN, DRAW_CULL_MARGIN};
+    if(entity->flags & ENTITY_FLAG_GROUND) area = get_bounds(entity);
+
+    for(u32 i = 0; i < STATIC_TILE_COUNT; i++) {
+        Static_Tile *tile = &g_static_cache.tiles[i];
+        if(tile->valid && CheckCollisionRecs(area, get_static_tile_rec(tile))) {
+            tile->valid = false;
+        }
+    }
+}
+
+static int
+compare_static_keys(const void *a, const void *b) {
+    u32 ka = *(const u32*)a;
+    u32 kb = *(const u32*)b;
+    return (ka > kb) - (ka < kb);
+}
+
+// Pushed as an offscreen pass, so the tile is redrawn before anything that
+// uses it. Ground goes under props, each in entity list order like
+// draw_entities.
+static void
+render_static_tile(Render_List *render, Static_Cache *cache, Static_Tile *tile, Entity_List *entity_list, Spatial_Grid *grid) {
+    Rectangle area = get_static_tile_rec(tile);
+    Rectangle query = expand_rec(area, DRAW_CULL_MARGIN);
+    s32 cx0 = get_grid_coord(query.x), cx1 = get_grid_coord(query.x + query.width);
+    s32 cy0 = get_grid_coord(query.y), cy1 = get_grid_coord(query.y + query.height);
+    u32 query_stamp = ++g_query_stamp;
+
+    u32 key_count = 0;
+    for(s32 cy = cy0; cy <= cy1; cy++) {
+        for(s32 cx = cx0; cx <= cx1; cx++) {
+            u32 *entries;
+            u32 entry_count = get_grid_cell(grid, cx, cy, &entries);
+            for(u32 i = 0; i < entry_count && key_count < MAX_STATIC_TILE_ENTITIES; i++) {
+                Entity *entity = &entity_list->entities[entries[i]];
+                if(entity->query_stamp == query_stamp || !entity->static_cached) continue;
+                entity->query_stamp = query_stamp;
+
+                cache->keys[key_count++] = ((u32)get_render_layer(entity) << 16) | entries[i];
+            }
+        }
+    }
+    qsort(cache->keys, key_count, sizeof(u32), compare_static_keys);
+
+    push_target(render, &tile->target, {area.x, area.y});
+    for(u32 i = 0; i < key_count; i++) {
+        Entity *entity = &entity_list->entities[cache->keys[i] & 0xffff];
+        u16 depth = (u16)(i + 1);
+        if(entity->flags & ENTITY_FLAG_GROUND) {
+            push_ground(render, RENDER_LAYER_OFFSCREEN, depth, get_bounds(entity), area);
+        } else {
+            Rectangle sprite_rec = get_region_rec(t_sprites, get_anim_sprite_rec(entity->sprite));
+            push_texture_rec(render, RENDER_LAYER_OFFSCREEN, depth, t_sprites.texture, sprite_rec, entity->pos, WHITE);
+        }
+    }
+
+    // Items are only dropped once the list is full. A tile missing any of its
+    // pass stays invalid and is redrawn next frame.
+    tile->valid = (render->count < MAX_DRAW_ITEMS);
+    g_static_cache_stats.redraws += 1;
+    g_static_cache_stats.entities += key_count;
+}
+
+// Renders any tiles in view that aren't valid and pushes them under the ground
+// layer's entities. The grid has to be the one draw_entities uses.
+static void
+draw_static_cache(Render_List *render, Static_Cache *cache, Entity_List *entity_list, Spatial_Grid *grid, Rectangle view) {
+    g_static_cache_stats.tiles = 0;
+    g_static_cache_stats.entities = 0;
+    if(!cache->enabled) return;
+
+    f64 start_time = sys_get_time();
+    cache->frame += 1;
+
+    s32 tx0 = (s32)floorf(view.x / STATIC_TILE_SIZE), tx1 = (s32)floorf((view.x + view.width) / STATIC_TILE_SIZE);
+    s32 ty0 = (s32)floorf(view.y / STATIC_TILE_SIZE), ty1 = (s32)floorf((view.y + view.height) / STATIC_TILE_SIZE);
+    for(s32 ty = ty0; ty <= ty1; ty++) {
+        for(s32 tx = tx0; tx <= tx1; tx++) {
+            Static_Tile *tile = nullptr;
+            Static_Tile *oldest = nullptr;
+            for(u32 i = 0; i < STATIC_TILE_COUNT; i++) {
+                Static_Tile *candidate = &cache->tiles[i];
+                if(candidate->x == tx && candidate->y == ty) {
+                    tile = candidate;
+                    break;
+                }
+                if(!oldest || candidate->last_used < oldest->last_used) {
+                    oldest = candidate;
+                }
+            }
+            if(!tile) {
+                // Never one drawn this frame, there are more tiles than the view overlaps
+                tile = oldest;
+                tile->x = tx;
+                tile->y = ty;
+                tile->valid = false;
+            }
+
+            if(!tile->valid) {
+                render_static_tile(render, cache, tile, entity_list, grid);
+            }
+            tile->last_used = cache->frame;
+
+            // Render textures are stored upside down
+            push_texture(render, RENDER_LAYER_GROUND, 0, tile->target.texture, {0, 0, STATIC_TILE_SIZE, -STATIC_TILE_SIZE},
+                         get_static_tile_rec(tile), WHITE);
+            g_static_cache_stats.tiles += 1;
+        }
+    }
+
+    g_static_cache_stats.draw_ms = (f32)((sys_get_time() - start_time) * 1000.0);
+}
@@ -1,6 +1,11 @@
 
 #include <sys/mman.h> // mmap
 #include <unistd.h>   // _SC_PAGESIZE
+#include <pthread.h>
+#include <semaphore.h>
+#include <time.h>     // clock_gettime
+#include <sys/stat.h> // mkdir
+#include <errno.h>
 
 static void* 
 sys_alloc_page(u64 *size) {
@@ -15,3 +20,79 @@ sys_free_page(void* pointer, u64 size) {
     munmap(pointer, size);
 }
 
+// Seconds on a monotonic clock, usable from any thread and without a window
+static f64
+sys_get_time() {
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (f64)now.tv_sec + (f64)now.tv_nsec * 1e-9;
+}
+
+typedef void (*Sys_Thread_Proc)(void *data);
+
+struct Sys_Thread {
+    pthread_t handle;
+    Sys_Thread_Proc proc;
+    void *data;
+};
+
+struct Sys_Semaphore {
+    sem_t handle;
+};
+
+static void*
+sys_thread_start(void *thread) {
+    Sys_Thread *t = (Sys_Thread*)thread;
+    t->proc(t->data);
+    return NULL;
+}
+
+static bool
+sys_create_thread(Sys_Thread *thread, Sys_Thread_Proc proc, void *data) {
+    thread->proc = proc;
+    thread->data = data;
+    return (pthread_create(&thread->handle, NULL, sys_thread_start, thread) == 0);
+}
+
+static void
+sys_join_thread(Sys_Thread *thread) {
+    pthread_join(thread->handle, NULL);
+}
+
+static void
+sys_init_semaphore(Sys_Semaphore *semaphore, u32 count) {
+    sem_init(&semaphore->handle, 0, count);
+}
+
+static void
+sys_destroy_semaphore(Sys_Semaphore *semaphore) {
+    sem_destroy(&semaphore->handle);
+}
+
+static void
+sys_wait_semaphore(Sys_Semaphore *semaphore) {
+    while(sem_wait(&semaphore->handle) != 0) {} // Interrupted by a signal
+}
+
+// Returns false instead of waiting when the count is 0
+static bool
+sys_try_wait_semaphore(Sys_Semaphore *semaphore) {
+    return (sem_trywait(&semaphore->handle) == 0);
+}
+
+static void
+sys_signal_semaphore(Sys_Semaphore *semaphore) {
+    sem_post(&semaphore->handle);
+}
+
+// Returns the value before the increment
+static u32
+sys_atomic_increment(volatile u32 *value) {
+    return __atomic_fetch_add(value, 1, __ATOMIC_RELAXED);
+}
+
+// Succeeds if the directory already exists
+static bool
+sys_create_directory(const char *path) {
+    return (mkdir(path, 0755) == 0 || errno == EEXIST);
+}
@@ -1,5 +1,12 @@
 #define _AMD64_
 #include <memoryapi.h>
+#include <processthreadsapi.h>
+#include <synchapi.h>
+#include <handleapi.h>
+#include <profileapi.h>
+#include <intrin.h>
+#include <fileapi.h>
+#include <errhandlingapi.h>
 
 static void* 
 sys_alloc_page(u64 *size) {
@@ -12,4 +19,82 @@ sys_free_page(void* pointer, u64 size) {
     VirtualFree(pointer, 0, MEM_RELEASE);
 }
 
+// Seconds on a monotonic clock, usable from any thread and without a window
+static f64
+sys_get_time() {
+    LARGE_INTEGER counter, frequency;
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+    return (f64)counter.QuadPart / (f64)frequency.QuadPart;
+}
+
+typedef void (*Sys_Thread_Proc)(void *data);
+
+struct Sys_Thread {
+    HANDLE handle;
+    Sys_Thread_Proc proc;
+    void *data;
+};
+
+struct Sys_Semaphore {
+    HANDLE handle;
+};
+
+static DWORD WINAPI
+sys_thread_start(LPVOID thread) {
+    Sys_Thread *t = (Sys_Thread*)thread;
+    t->proc(t->data);
+    return 0;
+}
+
+static bool
+sys_create_thread(Sys_Thread *thread, Sys_Thread_Proc proc, void *data) {
+    thread->proc = proc;
+    thread->data = data;
+    thread->handle = CreateThread(NULL, 0, sys_thread_start, thread, 0, NULL);
+    return (thread->handle != NULL);
+}
+
+static void
+sys_join_thread(Sys_Thread *thread) {
+    WaitForSingleObject(thread->handle, INFINITE);
+    CloseHandle(thread->handle);
+}
+
+static void
+sys_init_semaphore(Sys_Semaphore *semaphore, u32 count) {
+    semaphore->handle = CreateSemaphoreExW(NULL, count, 0x7fffffff, NULL, 0, SEMAPHORE_ALL_ACCESS);
+}
 
+static void
+sys_destroy_semaphore(Sys_Semaphore *semaphore) {
+    CloseHandle(semaphore->handle);
+}
+
+static void
+sys_wait_semaphore(Sys_Semaphore *semaphore) {
+    WaitForSingleObject(semaphore->handle, INFINITE);
+}
+
+// Returns false instead of waiting when the count is 0
+static bool
+sys_try_wait_semaphore(Sys_Semaphore *semaphore) {
+    return (WaitForSingleObject(semaphore->handle, 0) == WAIT_OBJECT_0);
+}
+
+static void
+sys_signal_semaphore(Sys_Semaphore *semaphore) {
+    ReleaseSemaphore(semaphore->handle, 1, NULL);
+}
+
+// Returns the value before the increment
+static u32
+sys_atomic_increment(volatile u32 *value) {
+    return (u32)_InterlockedIncrement((volatile long*)value) - 1;
+}
+
+// Succeeds if the directory already exists
+static bool
+sys_create_directory(const char *path) {
+    return (CreateDirectoryA(path, NULL) || GetLastError() == ERROR_ALREADY_EXISTS);
+}
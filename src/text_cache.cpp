@@ -0,0 +1,117 @@
+
+// Text cache for dialog and HUD text. DrawText lays out the string a glyph at
+// a time on every call; text that stays the same for many frames is instead
+// drawn once into a render texture slot and the slot is pushed as a single
+// quad until the text changes. Slots are keyed by string and font size and
+// reused least recently used first. Text is drawn white and tinted at draw
+// time, so the color isn't part of the key.
+//
+// Text that changes every frame (the debug overlay) would only churn slots
+// and keeps using push_text, as does text too long or tall for a slot.
+
+static constexpr u32 TEXT_CACHE_SLOTS = 16;
+static constexpr u32 MAX_CACHED_TEXT_LENGTH = 256;
+static constexpr s32 TEXT_SLOT_WIDTH = SCREEN_WIDTH;
+static constexpr s32 TEXT_SLOT_HEIGHT = 64;
+
+struct Text_Slot {
+    bool valid;
+    s32 size;
+    s32 width, height; // Of the laid out text
+    u32 last_used;
+    char text[MAX_CACHED_TEXT_LENGTH];
+    RenderTexture2D target;
+};
+
+struct Text_Cache {
+    bool enabled;
+    u32 frame;
+    Text_Slot slots[TEXT_CACHE_SLOTS];
+};
+static Text_Cache g_text_cache;
+
+struct Text_Cache_Stats {
+    u32 hits; // This frame
+    u32 layouts; // Since start
+};
+static Text_Cache_Stats g_text_cache_stats;
+
+// Needs the window
+static void
+init_text_cache(Text_Cache *cache) {
+    cache->enabled = true;
+    cache->frame = 0;
+    for(u32 i = 0; i < TEXT_CACHE_SLOTS; i++) {
+        Text_Slot *slot = &cache->slots[i];
+        slot->valid = false;
+        slot->last_used = 0;
+        slot->target = g_backend->load_render_texture(TEXT_SLOT_WIDTH, TEXT_SLOT_HEIGHT);
+    }
+}
+
+// Slots used before this in a frame are never evicted in it
+static void
+next_text_cache_frame(Text_Cache *cache) {
+    cache->frame += 1;
+    g_text_cache_stats.hits = 0;
+}
+
+// Same as push_text, drawn from a slot when the text fits one
+static void
+push_cached_text(Render_List *render, Text_Cache *cache, u8 layer, u16 depth, const char *text, s32 x, s32 y, s32 size, Color color) {
+    u32 length = (u32)strlen(text);
+    if(!cache->enabled || length >= MAX_CACHED_TEXT_LENGTH) {
+        push_text(render, layer, depth, text, x, y, size, color);
+        return;
+    }
+
+    Text_Slot *slot = nullptr;
+    Text_Slot *oldest = nullptr;
+    for(u32 i = 0; i < TEXT_CACHE_SLOTS; i++) {
+        Text_Slot *candidate = &cache->slots[i];
+        if(candidate->valid && candidate->size == size && strcmp(candidate->text, text) == 0) {
+            slot = candidate;
+            break;
+        }
+        if(!oldest || candidate->last_used < oldest->last_used) {
+            oldest = candidate;
+        }
+    }
+
+    if(slot) {
+        g_text_cache_stats.hits += 1;
+    } else {
+        // Same line height as DrawText
+        s32 lines = 1;
+        for(const char *c = text; *c; c++) {
+            if(*c == '\n') lines += 1;
+        }
+        s32 height = size + (lines - 1) * (size + size/2);
+
+        // MeasureText gives 0 without a window, headless slots are full width
+        s32 width = MeasureText(text, size);
+        if(width <= 0 || width > TEXT_SLOT_WIDTH) width = TEXT_SLOT_WIDTH;
+
+        if(height > TEXT_SLOT_HEIGHT || oldest->last_used == cache->frame) {
+            push_text(render, layer, depth, text, x, y, size, color);
+            return;
+        }
+
+        slot = oldest;
+        slot->valid = true;
+        slot->size = size;
+        slot->width = width;
+        slot->height = height;
+        memcpy(slot->text, text, length + 1);
+
+        push_target(render, &slot->target, {0, 0});
+        push_text(render, RENDER_LAYER_OFFSCREEN, 1, text, 0, 0, size, WHITE);
+        g_text_cache_stats.layouts += 1;
+    }
+    slot->last_used = cache->frame;
+
+    // Render textures are stored upside down, the text is at the top of the
+    // slot and so at the end of the texture
+    Rectangle src = {0, (f32)(TEXT_SLOT_HEIGHT - slot->height), (f32)slot->width, -(f32)slot->height};
+    push_texture(render, layer, depth, slot->target.texture, src, {(f32)x, (f32)y, (f32)slot->width, (f32)slot->height}, color);
+}
@@ -0,0 +1,204 @@
+
+// Hierarchical timer wheel. Timers are scheduled in simulation ticks and only
+// the ones that expire on a given tick are touched, so the per-tick cost is
+// O(expirations) instead of polling every object that has a countdown.
+//
+// Three levels of 64 slots: level 0 holds timers due within 64 ticks, level 1
+// within 64*64 ticks and level 2 within 64^3 ticks (~73 minutes at 60hz).
+// Higher levels are cascaded down whenever the level below wraps around.
+
+typedef u32 Timer_ID;
+typedef void (*Timer_Proc)(u32 target, u32 tag);
+
+static constexpr u32 TIMER_SLOT_BITS = 6;
+static constexpr u32 TIMER_SLOT_COUNT = 1 << TIMER_SLOT_BITS;
+static constexpr u32 TIMER_SLOT_MASK = TIMER_SLOT_COUNT - 1;
+static constexpr u32 TIMER_LEVEL_COUNT = 3;
+static constexpr u32 TIMER_MAX_DELAY = (1 << (TIMER_SLOT_BITS * TIMER_LEVEL_COUNT)) - 1;
+
+static constexpr u32 MAX_TIMER_COUNT = 128*1024;
+static constexpr u32 TIMER_INDEX_BITS = 17;
+static constexpr u32 TIMER_INDEX_MASK = (1 << TIMER_INDEX_BITS) - 1;
+static constexpr u32 TIMER_GENERATION_MASK = (1 << (32 - TIMER_INDEX_BITS)) - 1; // 15 bits, never 0
+static constexpr u32 TIMER_NIL = UINT32_MAX;
+
+struct Timer {
+    u32 expire_tick;
+    u32 target;
+    u32 tag;
+    Timer_Proc proc;
+
+    u32 next;
+    u32 prev;
+    u16 generation;
+    u16 slot; // level * TIMER_SLOT_COUNT + slot, UINT16_MAX when free
+};
+
+struct Timer_Wheel {
+    u32 tick;
+    u32 active_count;
+    u32 free_head;
+    u32 slots[TIMER_LEVEL_COUNT * TIMER_SLOT_COUNT];
+    Timer timers[MAX_TIMER_COUNT];
+};
+
+static Timer_Wheel *g_timers;
+
+// Generations wrap within the bits left over in a Timer_ID and skip 0, so an
+// id is never 0, which callers use for no timer
+inline static void
+bump_timer_generation(Timer *timer) {
+    timer->generation = (timer->generation + 1) & TIMER_GENERATION_MASK;
+    if(timer->generation == 0) timer->generation = 1;
+}
+
+static u32
+ticks_from_seconds(f32 seconds) {
+    u32 result = (u32)(seconds / TIME_STEP + 0.5f);
+    return (result > 0) ? result : 1;
+}
+
+static void
+init_timer_wheel(Timer_Wheel *wheel) {
+    wheel->tick = 0;
+    wheel->active_count = 0;
+    for(u32 i = 0; i < TIMER_LEVEL_COUNT * TIMER_SLOT_COUNT; i++) {
+        wheel->slots[i] = TIMER_NIL;
+    }
+
+    for(u32 i = 0; i < MAX_TIMER_COUNT; i++) {
+        Timer *timer = &wheel->timers[i];
+        timer->next = (i + 1 < MAX_TIMER_COUNT) ? i + 1 : TIMER_NIL;
+        timer->slot = UINT16_MAX;
+        // Keep generations across resets so stale ids never match a new timer
+        if(timer->generation == 0) timer->generation = 1;
+    }
+    wheel->free_head = 0;
+}
+
+// Drops every pending timer without firing it.
+static void
+clear_timers(Timer_Wheel *wheel) {
+    for(u32 i = 0; i < MAX_TIMER_COUNT; i++) {
+        bump_timer_generation(&wheel->timers[i]);
+    }
+    u32 tick = wheel->tick;
+    init_timer_wheel(wheel);
+    wheel->tick = tick;
+}
+
+static void
+link_timer(Timer_Wheel *wheel, u32 index) {
+    Timer *timer = &wheel->timers[index];
+    u32 delta = timer->expire_tick - wheel->tick;
+
+    u32 level = 0;
+    while(level + 1 < TIMER_LEVEL_COUNT && delta >= (1u << (TIMER_SLOT_BITS * (level + 1)))) {
+        level += 1;
+    }
+
+    u32 slot = level * TIMER_SLOT_COUNT + ((timer->expire_tick >> (TIMER_SLOT_BITS * level)) & TIMER_SLOT_MASK);
+    timer->slot = (u16)slot;
+    timer->prev = TIMER_NIL;
+    timer->next = wheel->slots[slot];
+    if(timer->next != TIMER_NIL) {
+        wheel->timers[timer->next].prev = index;
+    }
+    wheel->slots[slot] = index;
+}
+
+static void
+unlink_timer(Timer_Wheel *wheel, u32 index) {
+    Timer *timer = &wheel->timers[index];
+    if(timer->prev != TIMER_NIL) {
+        wheel->timers[timer->prev].next = timer->next;
+    } else {
+        wheel->slots[timer->slot] = timer->next;
+    }
+    if(timer->next != TIMER_NIL) {
+        wheel->timers[timer->next].prev = timer->prev;
+    }
+}
+
+static void
+free_timer(Timer_Wheel *wheel, u32 index) {
+    Timer *timer = &wheel->timers[index];
+    timer->slot = UINT16_MAX;
+    bump_timer_generation(timer);
+    timer->next = wheel->free_head;
+    wheel->free_head = index;
+    wheel->active_count -= 1;
+}
+
+// Schedules proc(target, tag) to run delay_ticks ticks from now. Returns 0 if
+// the pool is exhausted.
+static Timer_ID
+add_timer(Timer_Wheel *wheel, u32 delay_ticks, Timer_Proc proc, u32 target, u32 tag = 0) {
+    if(wheel->free_head == TIMER_NIL) return 0;
+
+    if(delay_ticks == 0) delay_ticks = 1;
+    if(delay_ticks > TIMER_MAX_DELAY) delay_ticks = TIMER_MAX_DELAY;
+
+    u32 index = wheel->free_head;
+    Timer *timer = &wheel->timers[index];
+    wheel->free_head = timer->next;
+    wheel->active_count += 1;
+
+    timer->expire_tick = wheel->tick + delay_ticks;
+    timer->target = target;
+    timer->tag = tag;
+    timer->proc = proc;
+    link_timer(wheel, index);
+
+    return ((u32)(timer->generation & TIMER_GENERATION_MASK) << TIMER_INDEX_BITS) | index;
+}
+
+static bool
+is_timer_pending(Timer_Wheel *wheel, Timer_ID id) {
+    if(id == 0) return false;
+    Timer *timer = &wheel->timers[id & TIMER_INDEX_MASK];
+    return (timer->slot != UINT16_MAX && (timer->generation & TIMER_GENERATION_MASK) == (id >> TIMER_INDEX_BITS));
+}
+
+static void
+cancel_timer(Timer_Wheel *wheel, Timer_ID id) {
+    if(!is_timer_pending(wheel, id)) return;
+    u32 index = id & TIMER_INDEX_MASK;
+    unlink_timer(wheel, index);
+    free_timer(wheel, index);
+}
+
+static void
+cascade_timers(Timer_Wheel *wheel, u32 level) {
+    u32 slot = level * TIMER_SLOT_COUNT + ((wheel->tick >> (TIMER_SLOT_BITS * level)) & TIMER_SLOT_MASK);
+    u32 index = wheel->slots[slot];
+    wheel->slots[slot] = TIMER_NIL;
+
+    while(index != TIMER_NIL) {
+        u32 next = wheel->timers[index].next;
+        link_timer(wheel, index);
+        index = next;
+    }
+}
+
+// Advances the wheel by one tick and fires every timer that expires on it.
+// Procs may freely add or cancel timers, including ones in the firing slot.
+static void
+advance_timers(Timer_Wheel *wheel) {
+    wheel->tick += 1;
+
+    for(u32 level = TIMER_LEVEL_COUNT - 1; level > 0; level--) {
+        if((wheel->tick & ((1u << (TIMER_SLOT_BITS * level)) - 1)) == 0) {
+            cascade_timers(wheel, level);
+        }
+    }
+
+    u32 slot = wheel->tick & TIMER_SLOT_MASK;
+    while(wheel->slots[slot] != TIMER_NIL) {
+        u32 index = wheel->slots[slot];
+        Timer timer = wheel->timers[index];
+        unlink_timer(wheel, index);
+        free_timer(wheel, index);
+        timer.proc(timer.target, timer.tag);
+    }
+}
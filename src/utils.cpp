@@ -6,7 +6,7 @@ struct Rand_State {
 };
 
 void init_rand(Rand_State *state) {
-    state->seed = (u64)(100000.0 *GetTime());
+    state->seed = (u64)(100000.0 *sys_get_time());
 }
 
 u64 get_rand(Rand_State *state) {
@@ -56,6 +56,10 @@ static Vector2 add_vec2(Vector2 a, Vector2 b) {
     return {a.x + b.x, a.y + b.y};
 }
 
+static Vector2 sub_vec2(Vector2 a, Vector2 b) {
+    return {a.x - b.x, a.y - b.y};
+}
+
 static Vector2 mul_vec2_f(Vector2 a, f32 b) {
     return {a.x * b, a.y * b};
 }
@@ -70,4 +74,13 @@ static void update_camera(Camera2D *cam, Vector2 player_pos) {
     cam->target.y = (player_pos.y + 16.f) - ((SCREEN_HEIGHT / cam->zoom) / 2.f);
 }
 
+// World space rectangle visible through the camera
+static Rectangle get_camera_view(Camera2D *cam) {
+    return {cam->target.x, cam->target.y, SCREEN_WIDTH / cam->zoom, SCREEN_HEIGHT / cam->zoom};
+}
+
+static Rectangle expand_rec(Rectangle rec, f32 amount) {
+    return {rec.x - amount, rec.y - amount, rec.width + amount*2.f, rec.height + amount*2.f};
+}
+
 